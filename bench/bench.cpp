@@ -0,0 +1,1015 @@
+// Host-native micro-benchmarks for the measurement core.
+// Build & run: pio run -e native -t exec
+// Reports ns/call and heap allocations/call for the hot paths of a wake cycle.
+
+#include <Arduino.h>
+#include <new>
+#include <vector>
+#include "hist.h"
+#include "types.h"
+#include "wsxx.h"
+#include "schedule.h"
+#include "histlog.h"
+#include "warm.h"
+#include "settings.h"
+#include "hwinv.h"
+#include "bootprof.h"
+#include "pulse.h"
+#include "fixtures.h"
+#include "reference.h"
+#include "BMP280.h"
+
+// Globals normally defined in main.cpp ----------------------------------------------------------------------------------------------------------------------
+int div_cpu = 1;
+bool usb_connected = false;
+bool errors_enabled = false;
+bool debug_enabled = false;
+bool test_with_usb = false;
+
+bool is_ws80 = false;
+bool is_ws85 = false;
+uint32_t last_wsxx_data = 0;
+int wind_dir_raw = 0;
+float wind_speed = 0;
+float wind_gust = 0;
+float temperature = 0;
+int humidity = 0;
+int light_lux = 0;
+float uv_level = 0;
+float wsxx_vcc = 0;
+float cap_voltage = 0;
+
+float batt_volt = 4.0;
+bool undervoltage = false;
+bool reduced_interval = false;
+float reduce_interval_voltage = 3.5;
+
+uint32_t broadcast_interval_weather = 40*1000UL;
+uint32_t last_msg_weather = 0;
+uint32_t broadcast_interval_name = 1000*60*5;
+uint32_t last_msg_name = 0;
+uint32_t broadcast_interval_info = 0;
+uint32_t last_msg_info = 0;
+uint32_t broadcast_scale_factor = 1;
+uint32_t last_fnet_send = 0;
+uint32_t fanet_cooldown = 4000;
+bool fanet_cooldown_ok(){ return time() - last_fnet_send > fanet_cooldown;}
+
+uint32_t sleeptime_cum = 0;
+uint32_t sleep_offset = 0;
+uint32_t boot_time = 0;
+
+// simulated clock, the bench decides how time advances
+uint32_t sim_time = 1000;
+uint32_t time(){
+  return sim_time;
+}
+
+// Allocation counter ----------------------------------------------------------------------------------------------------------------------
+static uint32_t alloc_count = 0;
+
+void* operator new(size_t n){
+  alloc_count++;
+  void* p = malloc(n ? n : 1);
+  if(!p){ throw std::bad_alloc(); }
+  return p;
+}
+void* operator new[](size_t n){ return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Helper ----------------------------------------------------------------------------------------------------------------------
+volatile uint32_t sink = 0; // keeps results alive so the compiler cannot drop the call
+
+static uint32_t rng_state = 0x12345678;
+static uint32_t rng(){
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+template<typename F>
+void bench(const char* name, uint32_t iterations, F fn){
+  for(uint32_t i = 0; i < iterations / 10 + 1; i++){ fn(); } // warm up
+  uint32_t allocs = alloc_count;
+  auto t0 = std::chrono::steady_clock::now();
+  for(uint32_t i = 0; i < iterations; i++){ fn(); }
+  auto t1 = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+  fprintf(stdout, "%-44s %12.1f ns/call %8.2f allocs/call\n", name, ns, (double)(alloc_count - allocs) / iterations);
+}
+
+// fill the wind ringbuffer with n slots of random but plausible readings, one set per WIND_HIST_STEP
+void fill_wind_history(int slots){
+  memset(wind_history, 0, sizeof(wind_history));
+  wind_hist_pos = 0;
+  wind_windows_reset();
+  for(int i = 0; i < slots; i++){
+    sim_time += WIND_HIST_STEP + 1;
+    float w = (rng() % 400) / 10.0;
+    add_wind_history_dir(rng() % 360);
+    add_wind_history_wind(w);
+    add_wind_history_gust(w + (rng() % 100) / 10.0);
+  }
+}
+
+// feed one sensor block into the UART stub and read it like the main loop does
+int read_block(const char* block){
+  Serial1.feed(block, strlen(block));
+  int res;
+  do {
+    res = read_wsxx();
+  } while(res == RESP_OK && Serial1.available());
+  return res;
+}
+
+// same with the former two pass reader
+int ref_read_block(const char* block){
+  Serial1.feed(block, strlen(block));
+  int res;
+  do {
+    res = ref_read_wsxx();
+  } while(res == RESP_OK && Serial1.available());
+  return res;
+}
+
+// run the lines of a block through the former parser without the UART wait, until BatVoltage
+void ref_parse_block(const char* block){
+  const char* pos = block;
+  const char* nl;
+  while((nl = strchr(pos, '\n'))){
+    if(process_line((char*)pos, nl - pos - 1, &ref_set_value)){ return;}
+    pos = nl + 1;
+  }
+}
+
+// stream a block through the parser without the UART wait, until BatVoltage
+void parse_block(const char* block){
+  for(const char* c = block; *c; c++){
+    if(wsxx_parse_char(*c) == RESP_COMPLETE){ return;}
+  }
+}
+
+int angle_diff(int a, int b){
+  int d = abs(a - b) % 360;
+  return d > 180 ? 360 - d : d;
+}
+
+// Checks ----------------------------------------------------------------------------------------------------------------------
+// percentile of the window against sorting the ringbuffer values within age
+bool check_gust_percentile(uint32_t age, uint8_t percentile){
+  uint32_t v[WIND_HIST_LEN];
+  int n = 0;
+  for(int i = 0; i < WIND_HIST_LEN; i++){
+    if(wind_history[i].time && (time() - wind_history[i].time) < age){ v[n++] = wind_history[i].gust;}
+  }
+  std::sort(v, v + n);
+  float expected = 0;
+  if(n){
+    int r = (int)ceil(percentile * n / 100.0);
+    expected = v[constrain(r, 1, n) - 1]/10.0;
+  }
+  return get_gust_percentile_from_hist(age, percentile) == expected;
+}
+
+// random walk through readings, rotations, sleeps and queries of several ages, compared against the full ringbuffer scan
+bool check_wind_windows(){
+  const uint32_t ages[] = {WIND_AGE, GUST_AGE, 1000*60*2, 1000*5};
+  uint32_t queries = 0, dir_checked = 0, errors = 0;
+  int max_dir_dev = 0;
+  int dir = 180;
+  memset(wind_history, 0, sizeof(wind_history));
+  wind_hist_pos = 0;
+  wind_windows_reset();
+
+  for(uint32_t i = 0; i < 200000; i++){
+    sim_time += (rng() % 8 == 0) ? rng() % 120000 : 500 + rng() % 8000; // mostly regular readings, sometimes a long sleep
+    dir = (dir + 340 + rng() % 41) % 360;
+    float w = (rng() % 500) / 10.0;
+    add_wind_history_dir(dir);
+    add_wind_history_wind(w);
+    add_wind_history_gust(w + (rng() % 100) / 10.0);
+
+    uint32_t age = ages[(rng() % 8 == 0) ? 2 + rng() % 2 : rng() % 2]; // mostly the two configured ages
+    WindSample a = get_wind_from_hist(age);
+    WindSample b = ref_get_wind_from_hist(age);
+    queries++;
+    if(a.wind != b.wind || a.gust != b.gust){ errors++; continue;}
+    if(get_gust_from_hist(age) != ref_get_gust_from_hist(age)){ errors++; continue;}
+    if(!check_gust_percentile(age, 1 + rng() % 100)){ errors++; continue;}
+    // skip direction where the mean vector is too short to define a heading
+    WindWindow *win = wind_window_get(age);
+    if(win->len && hypot(win->sum_x, win->sum_y) / win->len > 0.05 * 32767){
+      max_dir_dev = max(max_dir_dev, angle_diff(a.dir_raw, b.dir_raw));
+      dir_checked++;
+    }
+  }
+  if(max_dir_dev > 1){ errors++;}
+  fprintf(stdout, "%-44s %u queries, %u dir compared, max dir deviation %d deg, %u errors\n", "wind/gust windows vs. ringbuffer scan", queries, dir_checked, max_dir_dev, errors);
+  return errors == 0;
+}
+
+// Q15 table and integer atan2 against libm, then the direction average over all 360 degrees x N sample sets
+bool check_fixed_trig(){
+  uint32_t errors = 0;
+  int max_sin_err = 0;
+  for(int d = -720; d <= 720; d++){
+    max_sin_err = max(max_sin_err, (int)abs(sin_q15(d) - (int)lround(sin(d * M_PI / 180) * 32767)));
+    max_sin_err = max(max_sin_err, (int)abs(cos_q15(d) - (int)lround(cos(d * M_PI / 180) * 32767)));
+  }
+  if(max_sin_err > 1){ errors++;}
+
+  double max_atan_err = 0;
+  for(uint32_t i = 0; i < 1000000; i++){
+    int32_t range = (i & 1) ? 5000000 : 1000;
+    int32_t y = (int32_t)(rng() % (2 * range + 1)) - range;
+    int32_t x = (int32_t)(rng() % (2 * range + 1)) - range;
+    double err = fabs(atan2_q10(y, x) / 1024.0 - atan2(y, x) * 180 / M_PI);
+    if(err > 180){ err = 360 - err;}
+    max_atan_err = max(max_atan_err, err);
+  }
+  if(max_atan_err > 0.05){ errors++;}
+
+  const int N = 64;
+  int max_dir_dev = 0;
+  uint32_t compared = 0;
+  for(int d = 0; d < 360; d++){
+    for(int k = 0; k < N; k++){
+      int n = 1 + rng() % WIND_HIST_LEN;
+      int spread = 1 + rng() % 120;
+      float x_f = 0, y_f = 0;
+      int32_t x_i = 0, y_i = 0;
+      for(int j = 0; j < n; j++){
+        int dir = (d + 720 + (int)(rng() % (2 * spread + 1)) - spread) % 360;
+        x_f += cos (dir * M_PI / 180);
+        y_f += sin (dir * M_PI / 180);
+        x_i += cos_q15(dir);
+        y_i += sin_q15(dir);
+      }
+      if(hypot(x_f, y_f) / n < 0.05){ continue;} // no defined heading
+      int ref = atan2 (y_f / n, x_f / n) * 180 / M_PI;
+      if(ref < 0){ ref += 360;}
+      int fix = atan2_q10(y_i, x_i) / 1024;
+      if(fix < 0){ fix += 360;}
+      max_dir_dev = max(max_dir_dev, angle_diff(ref, fix));
+      compared++;
+    }
+  }
+  if(max_dir_dev > 1){ errors++;}
+  fprintf(stdout, "%-44s sin/cos max %d LSB, atan2 max %.4f deg, %u averages max %d deg, %u errors\n", "fixed point trig vs. libm", max_sin_err, max_atan_err, compared, max_dir_dev, errors);
+  return errors == 0;
+}
+
+// golden vectors: random measurements through the float encoder (as floats, the way the firmware held them) and the integer encoder
+bool check_fanet_golden(){
+  const uint32_t vectors = 100000;
+  uint32_t errors = 0;
+  for(uint32_t i = 0; i < vectors; i++){
+    uint32_t flags = rng();
+    weatherDataFixed fx = {};
+    fx.vid = rng() & 0xFF;
+    fx.fanet_id = rng() & 0xFFFF;
+    float lat = (int32_t)(rng() % 18000001 - 9000000) / 100000.0;
+    float lon = (int32_t)(rng() % 36000001 - 18000000) / 100000.0;
+    fx.lat_i = fanet_encode_lat(lat);
+    fx.lon_i = fanet_encode_lon(lon);
+    fx.bTemp = flags & 1;
+    fx.temp10 = (int)(rng() % 1001) - 400;
+    fx.bWind = flags & 2;
+    fx.heading = rng() % 360;
+    fx.speed10 = (flags & 0x100) ? rng() % 3000 : rng() % 300;
+    fx.gust10 = (flags & 0x200) ? rng() % 3000 : rng() % 300;
+    fx.bHumidity = flags & 4;
+    fx.humidity = rng() % 101;
+    fx.bBaro = flags & 8;
+    fx.baro10 = (flags & 0x400) ? -10 : 8000 + rng() % 3000;
+    fx.bStateOfCharge = flags & 16;
+    fx.charge = (flags & 0x800) ? (int)(rng() % 161) - 30 : rng() % 101;
+
+    weatherData wd;
+    wd.vid = fx.vid;
+    wd.fanet_id = fx.fanet_id;
+    wd.lat = lat;
+    wd.lon = lon;
+    wd.bTemp = fx.bTemp;
+    wd.temp = fx.temp10 / 10.0;
+    wd.bWind = fx.bWind;
+    wd.wHeading = fx.heading;
+    wd.wSpeed = fx.speed10 / 10.0;
+    wd.wGust = fx.gust10 / 10.0;
+    wd.bHumidity = fx.bHumidity;
+    wd.Humidity = fx.humidity;
+    wd.bBaro = fx.bBaro;
+    wd.Baro = fx.baro10 / 10.0;
+    wd.bStateOfCharge = fx.bStateOfCharge;
+    wd.Charge = fx.charge;
+
+    uint8_t a[sizeof(fanet_packet_t4)], b[sizeof(fanet_packet_t4)];
+    memset(a, 0xA5, sizeof(a));
+    memset(b, 0xA5, sizeof(b));
+    pack_weatherdata(&wd, a);
+    pack_weatherdata_fixed(&fx, b);
+    if(memcmp(a, b, sizeof(a))){ errors++;}
+  }
+  fprintf(stdout, "%-44s %u vectors, %u frames differ\n", "pack_weatherdata_fixed vs. pack_weatherdata", vectors, errors);
+  return errors == 0;
+}
+
+// measurement state after parsing a block
+typedef struct {
+  int dir; float speed; float gust; float temp; int hum; int lux; float uv; float cap; float vcc;
+  bool ws80; bool ws85; uint32_t last; uint32_t h_wind; uint32_t h_gust; int h_dir;
+} WsxxResult;
+
+void wsxx_clear(bool ws80, bool ws85){
+  wind_dir_raw = 0; wind_speed = 0; wind_gust = 0; temperature = 0; humidity = 0; light_lux = 0;
+  uv_level = 0; cap_voltage = 0; wsxx_vcc = 0; last_wsxx_data = 0;
+  is_ws80 = ws80; is_ws85 = ws85;
+  memset(wind_history, 0, sizeof(wind_history));
+  wind_hist_pos = 0;
+  wind_windows_reset();
+  memset(&wsxx, 0, sizeof(wsxx));
+}
+
+WsxxResult wsxx_result(){
+  WsxxResult r = {wind_dir_raw, wind_speed, wind_gust, temperature, humidity, light_lux, uv_level, cap_voltage, wsxx_vcc,
+    is_ws80, is_ws85, last_wsxx_data, wind_history[wind_hist_pos].wind, wind_history[wind_hist_pos].gust, wind_history[wind_hist_pos].dir_raw};
+  return r;
+}
+
+bool float_eq(float a, float b){ return fabsf(a - b) <= 1e-5f * max(1.0f, fabsf(a));}
+
+bool wsxx_result_eq(const WsxxResult &a, const WsxxResult &b){
+  return a.dir == b.dir && float_eq(a.speed, b.speed) && float_eq(a.gust, b.gust) && float_eq(a.temp, b.temp) && a.hum == b.hum &&
+    a.lux == b.lux && float_eq(a.uv, b.uv) && float_eq(a.cap, b.cap) && float_eq(a.vcc, b.vcc) && a.ws80 == b.ws80 && a.ws85 == b.ws85 &&
+    a.last == b.last && a.h_wind == b.h_wind && a.h_gust == b.h_gust && a.h_dir == b.h_dir;
+}
+
+// random number with up to max_dec decimals and an optional unit, the way the sensors print values
+void fuzz_number(std::string &out, bool allow_neg, int max_dec, uint32_t max_int){
+  static const char* const units[] = {"", "", "%", "V", " lux"};
+  if(allow_neg && rng() % 4 == 0){ out += "-";}
+  out += std::to_string(rng() % ((rng() % 4 == 0) ? max_int : min(max_int, 400u)));
+  int dec = rng() % (max_dec + 1);
+  if(dec){
+    out += ".";
+    for(int i = 0; i < dec; i++){ out += (char)('0' + rng() % 10);}
+  }
+  out += units[rng() % 5];
+}
+
+// random block: header, a mix of used keys, debug lines and noise, BatVoltage and the end marker
+std::string fuzz_block(bool ws85){
+  static const char* const keys[] = {"WindDir", "WindSpeed", "WindGust", "Temperature", "GXTS04Temp", "Humi", "Light", "UV_Value", "CapVoltage"};
+  static const char* const noise[] = {"-------SHT30--------", "Not Detected Pressure Sensor!", "Pressure     = --", "", "max = 787, min = 783",
+    "Source_CH1_3 = 100.00,3200", "WaveCnt[CH1]   = 0", "UltSignalRssi  = 2", "ResAdcSloCH1   = 0.0", ">> Device_ID  = 0x70014", "x_y = 53"};
+  std::string b = ws85 ? "========== WS85 Ver:1.0.7 ===========\r\n>> g_RrFreqSel = 868M\r\n" : "========== WH80 Ver:1.2.8 ===========\r\n>> RF_FreqSel = 868M\r\n";
+  int lines = 5 + rng() % 30;
+  for(int i = 0; i < lines; i++){
+    if(rng() % 3 == 0){
+      b += noise[rng() % 11];
+    } else {
+      int k = rng() % 9;
+      b += keys[k];
+      b += std::string(rng() % 8, ' ') + "=" + std::string(rng() % 3, ' ');
+      if(rng() % 20 == 0){ b += "--";}
+      else if(rng() % 20 != 0){
+        bool wind = k == 1 || k == 2; // m/s with 1 decimal, never negative
+        fuzz_number(b, !wind && k != 0 && k != 6, wind ? 2 : 3, wind ? 100 : 200000);
+      }
+    }
+    b += "\r\n";
+  }
+  b += "BatVoltage      = ";
+  fuzz_number(b, false, 2, 10);
+  b += "\r\n=====================================\r\n";
+  return b;
+}
+
+// streaming parser against process_line() + ref_set_value() on the recorded blocks and random ones
+bool check_wsxx_parser(){
+  uint32_t blocks = 0, errors = 0;
+  const char* fixtures[] = {FIXTURE_WS80, FIXTURE_WS85, FIXTURE_WS80_EXT};
+  for(int i = 0; i < 20003; i++){
+    bool ws80 = rng() & 1, ws85 = !ws80 && (rng() & 1);
+    std::string block = i < 3 ? std::string(fixtures[i]) : fuzz_block(rng() & 1);
+    wsxx_clear(ws80, ws85);
+    ref_parse_block(block.c_str());
+    WsxxResult a = wsxx_result();
+    wsxx_clear(ws80, ws85);
+    parse_block(block.c_str());
+    WsxxResult b = wsxx_result();
+    blocks++;
+    if(!wsxx_result_eq(a, b)){
+      if(!errors){ fprintf(stdout, "first mismatching block:\n%s\n", block.c_str());}
+      errors++;
+    }
+  }
+  fprintf(stdout, "%-44s %u blocks, %u differ\n", "streaming WSXX parser vs. two pass parser", blocks, errors);
+  return errors == 0;
+}
+
+// key as it would arrive from the sensor, through the streaming hash
+uint8_t lookup_key(const char* key){
+  wsxx_reset_line();
+  for(const char* c = key; *c; c++){ wsxx_parse_line_char(*c);}
+  return wsxx.key_len && wsxx.key_len <= WSXX_KEY_MAX ? wsxx_lookup_key() : (uint8_t)WSXX_NONE;
+}
+
+// keys of all lines in the fixtures, in order
+std::vector<std::string> fixture_keys(){
+  std::vector<std::string> keys;
+  const char* fixtures[] = {FIXTURE_WS80, FIXTURE_WS85, FIXTURE_WS80_EXT};
+  for(const char* f : fixtures){
+    std::string line;
+    for(const char* c = f; *c; c++){
+      if(*c == '\n'){
+        size_t eq = line.find('=');
+        if(eq != std::string::npos){
+          std::string key;
+          for(char k : line.substr(0, eq)){ if(k != ' ' && k != '\r'){ key += k;}}
+          if(!key.empty()){ keys.push_back(key);}
+        }
+        line.clear();
+      } else {
+        line += *c;
+      }
+    }
+  }
+  return keys;
+}
+
+// every key of the fixtures plus near misses of the known keys, hash dispatch vs. strcmp chain
+bool check_wsxx_keys(){
+  std::vector<std::string> keys = fixture_keys();
+  size_t known = keys.size();
+  for(uint8_t i = 1; i < WSXX_KEY_COUNT; i++){
+    std::string k = wsxx_keys[i];
+    keys.push_back(k + "x");
+    keys.push_back(k.substr(0, k.size() - 1));
+    keys.push_back(k.substr(1));
+    for(size_t p = 0; p < k.size(); p++){ std::string m = k; m[p] ^= 0x20; keys.push_back(m);}
+  }
+  uint32_t errors = 0, hits = 0;
+  for(const std::string &k : keys){
+    uint8_t a = ref_lookup_key(k.c_str());
+    uint8_t b = lookup_key(k.c_str());
+    if(a){ hits++;}
+    if(a != b){
+      if(!errors){ fprintf(stdout, "first mismatching key: %s (%u vs. %u)\n", k.c_str(), a, b);}
+      errors++;
+    }
+  }
+  fprintf(stdout, "%-44s %u keys (%u from fixtures), %u known, %u errors\n", "WSXX key hash vs. strcmp chain", (uint32_t)keys.size(), (uint32_t)known, hits, errors);
+  return errors == 0;
+}
+
+// random schedule/cancel/run on the task heap, the head must always be the earliest queued deadline (also across the time() overflow)
+uint8_t task_run_log[TASK_COUNT * 4];
+uint8_t task_run_count = 0;
+template<uint8_t ID> void task_log(){ if(task_run_count < sizeof(task_run_log)){ task_run_log[task_run_count++] = ID;}}
+
+bool check_scheduler(){
+  uint32_t errors = 0, ops = 0, runs = 0;
+  void (*fns[TASK_COUNT])() = {task_log<0>, task_log<1>, task_log<2>, task_log<3>, task_log<4>, task_log<5>};
+  uint32_t saved_time = sim_time, saved_send = last_fnet_send;
+  last_fnet_send = 0;
+  for(int round = 0; round < 2000; round++){
+    sim_time = round & 1 ? 0xFFFF0000u + rng() % 0x10000 : rng(); // half of the rounds close to the overflow
+    tasks_init();
+    for(uint8_t i = 0; i < TASK_COUNT; i++){ task_register(i, fns[i], rng() % 3 ? rng() % 60000 : 0, rng() & (TASK_SCALED | TASK_WAKE));}
+    for(int n = 0; n < 50; n++){
+      uint8_t id = rng() % TASK_COUNT;
+      if(rng() % 4){ task_schedule(id, sim_time + rng() % 100000 - 20000);} else { task_cancel(id);}
+      ops++;
+      // linear reference
+      int8_t min_id = -1;
+      uint8_t queued = 0;
+      for(uint8_t i = 0; i < TASK_COUNT; i++){
+        if(!task_queued(i)){ continue;}
+        queued++;
+        if(task_heap[tasks[i].heap_pos] != i){ errors++;}
+        if(min_id < 0 || task_before(i, min_id)){ min_id = i;}
+      }
+      if(queued != task_heap_len){ errors++;}
+      if(min_id >= 0 && tasks[task_heap[0]].deadline != tasks[min_id].deadline){ errors++;}
+    }
+    // run everything that is due, must come out in deadline order
+    uint32_t deadline[TASK_COUNT];
+    uint8_t due = 0;
+    for(uint8_t i = 0; i < TASK_COUNT; i++){
+      deadline[i] = tasks[i].deadline;
+      if(task_queued(i) && (int32_t)(sim_time - deadline[i]) >= 0){ due++;}
+    }
+    task_run_count = 0;
+    tasks_run();
+    bool order_ok = true;
+    for(uint8_t i = 1; i < task_run_count; i++){
+      if((int32_t)(deadline[task_run_log[i]] - deadline[task_run_log[i - 1]]) < 0){ order_ok = false;}
+    }
+    if(task_run_count != due || !order_ok){ errors++;}
+    runs += task_run_count;
+  }
+  sim_time = saved_time;
+  last_fnet_send = saved_send;
+  fprintf(stdout, "%-44s %u ops, %u runs, %u errors\n", "task heap vs. linear scan", ops, runs, errors);
+  return errors == 0;
+}
+
+// BMP280 integer compensation against the double path: datasheet example, then the datasheet calibration and
+// random ones around it over the whole 20 bit ADC range, wherever the double path gives a plausible reading
+bool check_bmp280_compensation(){
+  const int16_t datasheet[12] = {27504, 26435, -1000, (int16_t)36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000};
+  BMP280 bmp;
+  uint32_t compared = 0, errors = 0;
+  double max_dt = 0, max_dp = 0;
+
+  for(int set = 0; set < 8; set++){
+    uint8_t raw[24];
+    for(int i = 0; i < 12; i++){
+      int32_t v = datasheet[i];
+      if(set && i != 0 && i != 3){ v += (int32_t)(rng() % 2001) - 1000;} // signed coefficients, T1/P1 stay plausible
+      raw[2*i] = v & 0xFF;
+      raw[2*i + 1] = (v >> 8) & 0xFF;
+    }
+    bmp.setCalibration(raw);
+
+    if(set == 0){ // BMP280 datasheet section 8.2 example, the table lists 25767236, the formula gives 3/256 Pa less
+      int32_t t = bmp.compensateTemperature(519888);
+      uint32_t p = bmp.compensatePressure(415148);
+      if(t != 2508 || abs((int32_t)p - 25767236) > 4){
+        fprintf(stdout, "  datasheet example: T %d (2508), P %u (25767236)\n", t, p);
+        errors++;
+      }
+    }
+
+    for(int32_t adc_T = 0; adc_T < (1 << 20); adc_T += 997){
+      double uT = adc_T, T;
+      bool t_ok = bmp.calcTemperature(T, uT);
+      int32_t ti = bmp.compensateTemperature(adc_T);
+      if(!t_ok){ continue;}
+      double dt = fabs(ti / 100.0 - T);
+      max_dt = max(max_dt, dt);
+      if(dt > 0.01){ errors++;}
+
+      for(int32_t adc_P = 0; adc_P < (1 << 20); adc_P += 4099){
+        double P;
+        bmp.calcPressure(P, adc_P);
+        if(!(P > 300 && P < 1250)){ continue;} // mBar
+        uint32_t pi = bmp.compensatePressure(adc_P);
+        double dp = fabs(pi / 256.0 - P * 100); // Pa
+        max_dp = max(max_dp, dp);
+        if(dp > 2.0){ errors++;} // the integer formula truncates intermediates, still far below the 0.1 hPa sent
+        compared++;
+      }
+    }
+  }
+  fprintf(stdout, "%-44s %u readings, max %.4f C / %.3f Pa, %u errors\n", "BMP280 integer vs. double compensation", compared, max_dt, max_dp, errors);
+  return errors == 0;
+}
+
+// history log: 30 days of HISTORY_INTERVAL records with random resets, after each restore history[] must hold the newest
+// records that made it into a full row; then a corrupted newest row must fall back to the one before
+bool check_histlog(){
+  uint32_t saved_time = sim_time;
+  std::vector<History> ref; // every record in flash, oldest first
+  uint32_t restores = 0, errors = 0;
+  const uint32_t days = 30;
+  const uint32_t records = days*24*3600/(HISTORY_INTERVAL/1000);
+
+  auto reboot = [&](){
+    for(int i = 0; i < HISTORY_LEN; i++){ history[i].set = false;}
+    hist_count = 0;
+    histlog_restore();
+    restores++;
+    size_t n = std::min(ref.size(), (size_t)HISTORY_LEN);
+    for(size_t i = 0; i < n; i++){
+      History &h = history[histlog_pos(i)];
+      const History &r = ref[ref.size() - 1 - i];
+      if(!h.set || h.wind != r.wind || h.temp != r.temp || h.humd != r.humd || h.light != r.light || h.batt != r.batt ||
+         h.pv_charging != r.pv_charging || h.pv_done != r.pv_done){ errors++; break;}
+    }
+    if(n < HISTORY_LEN && history[histlog_pos(n)].set){ errors++;}
+  };
+
+  memset(histlog_sim, 0xFF, sizeof(histlog_sim));
+  memset(histlog_erases, 0, sizeof(histlog_erases));
+  reboot();
+  std::vector<History> pending;
+  for(uint32_t i = 0; i < records; i++){
+    sim_time += HISTORY_INTERVAL + 1;
+    if(!save_history((rng() % 120)/10.0, (int)(rng() % 60) - 20, rng() % 100, rng() % 12000, 3.0 + (rng() % 27)/100.0, rng() & 1, rng() & 1)){ errors++;}
+    histlog_append();
+    pending.push_back(history[hist_count]);
+    if(histlog_pending == 0){ // row written
+      ref.insert(ref.end(), pending.begin(), pending.end());
+      pending.clear();
+    }
+    if(rng() % 500 == 0){ // reset, the records not in a full row are lost
+      pending.clear();
+      reboot();
+    }
+  }
+  uint32_t max_erases = 0;
+  for(int i = 0; i < HISTLOG_ROWS; i++){ max_erases = max(max_erases, histlog_erases[i]);}
+  if(max_erases >= days){ errors++;}
+
+  // corrupt the newest row: restore must end at the row before
+  uint16_t newest = (histlog_next + HISTLOG_ROWS - 1) % HISTLOG_ROWS;
+  histlog_sim[newest*HISTLOG_ROW_SIZE + 20] ^= 0x55;
+  ref.resize(ref.size() - HISTLOG_ROW_RECORDS);
+  reboot();
+  if(histlog_next != newest){ errors++;}
+
+  sim_time = saved_time;
+  fprintf(stdout, "%-44s %u records, %u restores, max %.2f erases/row/day, %u errors\n", "history log restore vs. records written",
+          records, restores, (double)max_erases/days, errors);
+  return errors == 0;
+}
+
+// warm restart: after a seal and a reset (statics back to their initializers, NOINIT untouched) the buffers and
+// positions must be taken over unchanged; a changed byte or a second restore without seal must start clean
+bool check_warm_restart(){
+  uint32_t errors = 0;
+  fill_wind_history(WIND_HIST_LEN + 17);
+  for(int i = 0; i < 100; i++){
+    sim_time += HISTORY_INTERVAL + 1;
+    save_history((rng() % 120)/10.0, (int)(rng() % 60) - 20, rng() % 100, rng() % 12000, 3.8, rng() & 1, rng() & 1);
+  }
+  histlog_pending = 7;
+  last_msg_weather = sim_time - 1234;
+  last_fnet_send = sim_time - 99;
+  std::vector<uint8_t> wind_ref((uint8_t*)wind_history, (uint8_t*)wind_history + sizeof(wind_history));
+  std::vector<uint8_t> hist_ref((uint8_t*)history, (uint8_t*)history + sizeof(history));
+  int count_ref = hist_count;
+  uint8_t pos_ref = wind_hist_pos;
+  uint32_t weather_ref = last_msg_weather, fnet_ref = last_fnet_send, last_history_ref = last_history;
+  uint32_t time_ref = time();
+
+  auto reset = [](){
+    last_msg_weather = last_msg_name = last_msg_info = last_fnet_send = last_history = 0;
+    hist_count = 0;
+    wind_hist_pos = 0;
+    histlog_pending = 0;
+    sleeptime_cum = 0;
+  };
+
+  warm_seal();
+  reset();
+  if(!warm_restore()){ errors++;}
+  if(memcmp(wind_ref.data(), wind_history, sizeof(wind_history)) || memcmp(hist_ref.data(), history, sizeof(history))){ errors++;}
+  if(hist_count != count_ref || wind_hist_pos != pos_ref || histlog_pending != 7 || last_msg_weather != weather_ref ||
+     last_fnet_send != fnet_ref || last_history != last_history_ref){ errors++;}
+  if(sleeptime_cum + millis() != time_ref || boot_time != sleeptime_cum){ errors++;} // uptime() from this reset
+  if(save_history(1.0, 20, 50, 100, 3.8, false, false)){ errors++;} // restored last_history, not due yet
+  // first sends one period after the restored last ones
+  task_register(TASK_WEATHER, task_log<0>, 60000, 0);
+  if(task_first_deadline(TASK_WEATHER, last_msg_weather) != weather_ref + 60000 ||
+     task_first_deadline(TASK_WEATHER, time() - 70000) != time() || task_first_deadline(TASK_WEATHER, 0) != time() + 60000){ errors++;}
+  if(warm_restore()){ errors++;} // magic is used up
+
+  warm_seal();
+  history[count_ref].temp ^= 0x01; // changed after the seal, e.g. reset in the middle of a wake
+  reset();
+  if(warm_restore()){ errors++;}
+
+  warm_seal();
+  warm.wind_hist_pos ^= 0x01;
+  if(warm_restore()){ errors++;}
+
+  // watchdog reset while awake: a reading after the seal fails until loop() seals again
+  warm_seal();
+  add_wind_history_wind(7.5);
+  if(!hist_dirty || warm_state_crc() == warm.crc){ errors++;}
+  warm_seal();
+  if(hist_dirty || !warm_restore()){ errors++;}
+
+  sleeptime_cum = boot_time = 0;
+  fprintf(stdout, "%-44s %u errors\n", "warm restart restore vs. sealed state", errors);
+  return errors == 0;
+}
+
+// settings snapshot key: a synthetic FAT12 volume, bare and behind an MBR, must give the same key; a changed directory
+// entry or first cluster must change it, a missing file must give 0; the snapshot only loads for its key
+bool check_settings_snapshot(){
+  uint32_t errors = 0;
+  std::vector<uint8_t> vol(40*1024, 0xFF);
+  uint8_t *bs = vol.data();
+  memset(bs, 0, 512);
+  bs[0] = 0xEB; bs[11] = 0x00; bs[12] = 0x02; // 512 byte sectors
+  bs[13] = 2; bs[14] = 1; bs[16] = 2; bs[17] = 64; bs[22] = 1; // 2 sectors per cluster, 1 reserved, 2 FATs of 1 sector, 64 root entries
+  uint8_t *root = bs + 3*512;
+  memset(root, 0, 64*32);
+  memcpy(root, "BREEZEDUDE ", 11); root[11] = 0x08; // volume label
+  memcpy(root + 32, "OLD     TXT", 11); root[32] = 0xE5; // deleted
+  uint8_t *e = root + 64;
+  const char *file = "NAME=Bench\nLAT=47.1\nLON=11.2\nALT=1500\n";
+  memcpy(e, "SETTINGSTXT", 11); e[26] = 3; e[28] = strlen(file); // first cluster 3
+  uint8_t *data = bs + (3 + 4 + 2)*512; // root + 4 root sectors + cluster 2
+  memcpy(data, file, strlen(file));
+
+  uint32_t key = settings_file_key(vol.data(), vol.size(), "SETTINGSTXT");
+  if(!key || key != settings_file_key(vol.data(), vol.size(), "SETTINGSTXT")){ errors++;}
+  if(settings_file_key(vol.data(), vol.size(), "VERSION TXT")){ errors++;}
+
+  std::vector<uint8_t> part(vol.size() + 4*512, 0);
+  memcpy(&part[4*512], vol.data(), vol.size());
+  part[446 + 8] = 4; part[510] = 0x55; part[511] = 0xAA;
+  if(settings_file_key(part.data(), part.size(), "SETTINGSTXT") != key){ errors++;}
+
+  data[20] ^= 0x01; // content
+  if(settings_file_key(vol.data(), vol.size(), "SETTINGSTXT") == key){ errors++;}
+  data[20] ^= 0x01;
+  e[22] ^= 0x01; // modification time
+  if(settings_file_key(vol.data(), vol.size(), "SETTINGSTXT") == key){ errors++;}
+  e[22] ^= 0x01;
+
+  SettingsValues v, r;
+  memset(&v, 0, sizeof(v));
+  strcpy(v.station_name, "Bench");
+  v.pos_lat = 47.1;
+  v.gust_rank = 3;
+  SettingsSnapshot erased;
+  memset(&erased, 0, sizeof(erased));
+  settings_snap_write(erased);
+  if(settings_snapshot_load(key, r)){ errors++;} // erased slot
+  settings_snapshot_save(key, v);
+  if(!settings_snapshot_load(key, r) || memcmp(&r, &v, sizeof(v))){ errors++;}
+  if(settings_snapshot_load(key + 1, r) || settings_snapshot_load(0, r)){ errors++;}
+
+  fprintf(stdout, "%-44s %u errors\n", "settings snapshot key and slot", errors);
+  return errors == 0;
+}
+
+// inventory row: erased, saved, read back after hwinv was lost (reset)
+bool check_hwinv(){
+  uint32_t errors = 0;
+  HwInventory erased;
+  memset(&erased, 0, sizeof(erased));
+  hwinv_write(erased);
+  if(hwinv_load()){ errors++;}
+  hwinv_save(2, 3, 1, true);
+  memset(&hwinv, 0, sizeof(hwinv));
+  if(!hwinv_load() || hwinv.hw_version != 2 || hwinv.lora_module != 3 || hwinv.baro_chip != 1 || !hwinv.display){ errors++;}
+  fprintf(stdout, "%-44s %u errors\n", "hardware inventory row", errors);
+  return errors == 0;
+}
+
+// boot profile text for the info frame: phases under 1 ms left out, truncation like snprintf (untruncated length returned,
+// nothing written past the buffer)
+bool check_boot_format(){
+  uint32_t errors = 0;
+  boot_begin();
+  const uint16_t ms[BOOT_PHASES] = {480, 61, 0, 35, 2, 2113, 1, 30, 12};
+  memcpy(boot_ms, ms, sizeof(boot_ms));
+  boot_total = 2734;
+  const char *expect = "boot 2734ms C480 I61 F35 S2 R2113 P1 B30 O12";
+  char buf[64];
+  int len = boot_format(buf, sizeof(buf));
+  if(len != (int)strlen(expect) || strcmp(buf, expect)){ errors++;}
+  for(int size = 1; size < (int)strlen(expect) + 2; size++){
+    char small[64];
+    memset(small, 0x55, sizeof(small));
+    if(boot_format(small, size) != len || strncmp(small, expect, size - 1) || small[size - 1] != 0 || small[size] != 0x55){ errors++;}
+  }
+  fprintf(stdout, "%-44s \"%s\", %u errors\n", "boot profile info text", buf, errors);
+  return errors == 0;
+}
+
+// pulse interval stats: random intervals (with overflow captures) anywhere in the ring against a quadratic scan of all
+// windows; a 3 s burst in steady wind must give the burst speed as gust
+bool check_pulse_stats(){
+  uint32_t errors = 0;
+  const uint16_t len = 64;
+  uint16_t ring[len];
+  for(int run = 0; run < 200; run++){
+    for(uint16_t i = 0; i < len; i++){
+      uint32_t r = rng();
+      ring[i] = (r % 16) == 0 ? 0 : (r % 4) == 0 ? 200 + (r >> 8) % 3000 : 20 + (r >> 8) % 400;
+    }
+    uint16_t start = rng() % len, n = rng() % (len + 1);
+    PulseStats s;
+    pulse_stats(ring, len, start, n, s);
+
+    float gust = 0;
+    uint32_t min_ticks = 0;
+    uint16_t hist[PULSE_HIST_BINS] = {};
+    for(uint16_t j = 0; j < n; j++){
+      uint32_t t = pulse_interval(ring[(start + j) % len]);
+      if(!min_ticks || t < min_ticks){ min_ticks = t;}
+      hist[pulse_hist_bin(t)]++;
+      uint32_t sum = 0;
+      for(int i = j; i >= 0; i--){ // shortest window ending at j with at least 3 s
+        sum += pulse_interval(ring[(start + i) % len]);
+        if(sum >= PULSE_GUST_TICKS || i == 0){
+          gust = max(gust, pulse_speed(j - i + 1, max(sum, (uint32_t)PULSE_GUST_TICKS)));
+          break;
+        }
+      }
+    }
+    if(s.count != n || s.min_ticks != min_ticks || memcmp(s.hist, hist, sizeof(hist)) || fabsf(s.gust - gust) > 1e-3f * gust){ errors++;}
+  }
+
+  // 12 s at 10 km/h (371 ticks), 3 s of 50 km/h (74 ticks) in the middle
+  uint16_t n = 0;
+  pulse_ring[0] = 5; // setup to the first pulse, not an interval
+  for(uint32_t t = 0; t < 4500; t += 371){ pulse_ring[1 + n++] = 371;}
+  for(uint32_t t = 0; t < 3072; t += 74){ pulse_ring[1 + n++] = 74;}
+  for(uint32_t t = 0; t < 4500; t += 371){ pulse_ring[1 + n++] = 371;}
+  PulseStats s;
+  pulse_capture_stats(n + 1, false, s);
+  if(s.count != n || s.min_ticks != 74 || s.gust < 48 || s.gust > 52){ errors++;}
+
+  // longest Davis sleep at PULSE_MAX_KMH: no wrap, the 3 s gust of the last intervals is still there
+  const float max_ticks = PULSE_KMH_TICKS / PULSE_MAX_KMH;
+  n = 0;
+  for(float t = max_ticks; t <= PULSE_RING_MS * PULSE_TICKS_PER_S / 1000.0f && n < PULSE_RING_LEN - 1; t += max_ticks){
+    pulse_ring[1 + n++] = (uint16_t)(t + 0.5f) - (uint16_t)(t - max_ticks + 0.5f);
+  }
+  PulseStats m;
+  pulse_capture_stats(n + 1, false, m);
+  if(n + 1 >= PULSE_RING_LEN || m.count != n || fabsf(m.gust - PULSE_MAX_KMH) > 0.02f * PULSE_MAX_KMH){ errors++;}
+  fprintf(stdout, "%-44s gust %.1f km/h, %u errors\n", "pulse interval gust and histogram", s.gust, errors);
+  return errors == 0;
+}
+
+// WMO wind engine: random walk like check_wind_windows against a scan of the closed slots by bucket, then the Yamartino
+// sigma of a steady and of a +-30 deg alternating direction
+bool check_wmo_wind(){
+  uint32_t errors = 0;
+  memset(wind_history, 0, sizeof(wind_history));
+  wind_hist_pos = 0;
+  wind_windows_reset();
+  wmo_reset();
+  int dir = 180;
+  for(uint32_t i = 0; i < 100000; i++){
+    sim_time += (rng() % 16 == 0) ? rng() % 900000 : 500 + rng() % 12000;
+    dir = (dir + 340 + rng() % 41) % 360;
+    float w = (rng() % 500) / 10.0;
+    add_wind_history_dir(dir);
+    add_wind_history_wind(w);
+    add_wind_history_gust(w + (rng() % 100) / 10.0);
+
+    bool short_mean = rng() % 2;
+    WmoWind a = wmo_get(short_mean);
+    uint32_t epoch = time() / WMO_BUCKET_MS, n = short_mean ? WMO_SHORT_BUCKETS : WMO_BUCKETS;
+    uint32_t sum = 0, count = 0;
+    int32_t x = 0, y = 0;
+    uint16_t gust = 0;
+    for(int p = 0; p < WIND_HIST_LEN; p++){
+      const WindSample &c = wind_history[p];
+      if(!c.time){ continue;}
+      bool in_mean, in_gust;
+      if(p == wind_hist_pos){
+        in_mean = in_gust = time() - c.time < n * WMO_BUCKET_MS;
+      } else {
+        in_mean = epoch - c.time / WMO_BUCKET_MS < n;
+        in_gust = epoch - c.time / WMO_BUCKET_MS < WMO_BUCKETS;
+      }
+      if(in_gust){ gust = max(gust, gust_key(c.gust));}
+      if(in_mean){ sum += c.wind; x += dir_x(c.dir_raw); y += dir_y(c.dir_raw); count++;}
+    }
+    if(a.count != count || (count && (a.wind10 != sum / count || a.gust10 != gust))){ errors++;}
+  }
+
+  float sigma[2];
+  for(int k = 0; k < 2; k++){
+    memset(wind_history, 0, sizeof(wind_history));
+    wind_hist_pos = 0;
+    wmo_reset();
+    for(int i = 0; i < 40; i++){
+      sim_time += 5000;
+      add_wind_history_dir(k ? (i % 2 ? 30 : 330) : 250);
+      add_wind_history_wind(10);
+    }
+    sigma[k] = wmo_get(false).sigma;
+  }
+  if(sigma[0] > 1 || sigma[1] < 29 || sigma[1] > 32){ errors++;}
+  fprintf(stdout, "%-44s sigma %.1f / %.1f deg, %u errors\n", "WMO means and gust vs. slot scan", sigma[0], sigma[1], errors);
+  return errors == 0;
+}
+
+int main(){
+  fprintf(stdout, "Breezedude measurement core bench\n\n");
+  bool ok = true;
+
+  ok &= check_fixed_trig();
+  ok &= check_wind_windows();
+  ok &= check_fanet_golden();
+  ok &= check_scheduler();
+  ok &= check_wsxx_parser();
+  ok &= check_wsxx_keys();
+  ok &= check_bmp280_compensation();
+  ok &= check_histlog();
+  ok &= check_warm_restart();
+  ok &= check_settings_snapshot();
+  ok &= check_hwinv();
+  ok &= check_boot_format();
+  ok &= check_pulse_stats();
+  ok &= check_wmo_wind();
+  fprintf(stdout, "\n");
+
+  // Wind history ----------------------------------------------------------------------------------------------------------------------
+  fill_wind_history(WIND_HIST_LEN * 2);
+  bench("get_wind_from_hist(WIND_AGE)", 200000, []{ sink += get_wind_from_hist(WIND_AGE).dir_raw; });
+  bench("get_wind_from_hist(GUST_AGE)", 200000, []{ sink += get_wind_from_hist(GUST_AGE).dir_raw; });
+  bench("ref_get_wind_from_hist(WIND_AGE) (scan)", 200000, []{ sink += ref_get_wind_from_hist(WIND_AGE).dir_raw; });
+  bench("ref_get_wind_from_hist(GUST_AGE) (scan)", 200000, []{ sink += ref_get_wind_from_hist(GUST_AGE).dir_raw; });
+  bench("wmo_get (10 min mean, 3 s gust)", 200000, []{ sink += wmo_get(false).gust10; });
+  bench("get_gust_from_hist(GUST_AGE)", 200000, []{ sink += (uint32_t)get_gust_from_hist(GUST_AGE); });
+  bench("get_gust_percentile_from_hist(GUST_AGE, 95)", 200000, []{ sink += (uint32_t)get_gust_percentile_from_hist(GUST_AGE, 95); });
+  bench("ref_get_gust_from_hist(GUST_AGE) (scan)", 200000, []{ sink += (uint32_t)ref_get_gust_from_hist(GUST_AGE); });
+  bench("add_wind_history_* (one reading)", 200000, []{
+    sim_time += 1000;
+    add_wind_history_dir(rng() % 360);
+    add_wind_history_wind(12.3);
+    add_wind_history_gust(15.6);
+  });
+
+  // FANET encoding ----------------------------------------------------------------------------------------------------------------------
+  weatherData wd = {};
+  wd.vid = 0x11; wd.fanet_id = 0x1234;
+  wd.lat = 47.1234; wd.lon = 11.5678;
+  wd.bTemp = true; wd.temp = 12.3;
+  wd.bWind = true; wd.wHeading = 231; wd.wSpeed = 18.4; wd.wGust = 27.9;
+  wd.bHumidity = true; wd.Humidity = 67;
+  wd.bBaro = true; wd.Baro = 1013.2;
+  wd.bStateOfCharge = true; wd.Charge = 83;
+  uint8_t frame[sizeof(fanet_packet_t4)];
+  bench("pack_weatherdata", 1000000, [&]{ pack_weatherdata(&wd, frame); sink += frame[5]; });
+  weatherDataFixed wdf = {0x11, 0x1234, fanet_encode_lat(47.1234), fanet_encode_lon(11.5678), true, 123, true, 231, 184, 279, true, 67, true, 10132, true, 83};
+  bench("pack_weatherdata_fixed", 1000000, [&]{ pack_weatherdata_fixed(&wdf, frame); sink += frame[5]; });
+  uint8_t weather_template[sizeof(fanet_packet_t4)] = {};
+  pack_weatherdata_header((fanet_packet_t4 *)weather_template, wdf.vid, wdf.fanet_id, wdf.lat_i, wdf.lon_i);
+  bench("template copy + pack_weatherdata_values", 1000000, [&]{ memcpy(frame, weather_template, sizeof(frame)); pack_weatherdata_values(&wdf, frame); sink += frame[5]; });
+
+  // WSXX parse path ----------------------------------------------------------------------------------------------------------------------
+  bench("process_line+ref_set_value (WS80 block)", 20000, []{ ref_parse_block(FIXTURE_WS80); });
+  bench("wsxx_parse_char (WS80 block)", 20000, []{ parse_block(FIXTURE_WS80); });
+  bench("process_line+ref_set_value (WS85 block)", 20000, []{ ref_parse_block(FIXTURE_WS85); });
+  bench("wsxx_parse_char (WS85 block)", 20000, []{ parse_block(FIXTURE_WS85); });
+  bench("process_line+ref_set_value (WS80 extended)", 20000, []{ ref_parse_block(FIXTURE_WS80_EXT); });
+  bench("wsxx_parse_char (WS80 extended)", 20000, []{ parse_block(FIXTURE_WS80_EXT); });
+  static std::vector<std::string> keys = fixture_keys();
+  bench("ref_lookup_key (all fixture keys)", 20000, []{ for(const std::string &k : keys){ sink += ref_lookup_key(k.c_str());} });
+  static std::vector<WsxxParser> hashed; // key as the streaming parser leaves it at the '='
+  for(const std::string &k : keys){ lookup_key(k.c_str()); hashed.push_back(wsxx);}
+  bench("wsxx_lookup_key (all fixture keys)", 20000, []{ for(const WsxxParser &p : hashed){ wsxx = p; sink += wsxx_lookup_key();} });
+
+  size_t ws80_len = strlen(FIXTURE_WS80), ws85_len = strlen(FIXTURE_WS85);
+  auto throughput = [](const char* name, size_t len, uint32_t iterations, void (*fn)(const char*), const char* block){
+    auto t0 = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < iterations; i++){ fn(block); }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    fprintf(stdout, "%-44s %12.1f MB/s\n", name, len * (double)iterations / s / 1e6);
+  };
+  throughput("two pass throughput (WS80 block)", ws80_len, 20000, ref_parse_block, FIXTURE_WS80);
+  throughput("streaming throughput (WS80 block)", ws80_len, 20000, parse_block, FIXTURE_WS80);
+  throughput("two pass throughput (WS85 block)", ws85_len, 20000, ref_parse_block, FIXTURE_WS85);
+  throughput("streaming throughput (WS85 block)", ws85_len, 20000, parse_block, FIXTURE_WS85);
+
+  is_ws80 = true; is_ws85 = false;
+  ref_read_block(FIXTURE_WS80); // settle serial_wait after detection
+  bench("ref_read_wsxx WS80 block (incl. idle timeout)", 50, []{ sink += ref_read_block(FIXTURE_WS80); });
+  read_block(FIXTURE_WS80);
+  bench("read_wsxx WS80 block (incl. idle timeout)", 50, []{ sink += read_block(FIXTURE_WS80); });
+  is_ws80 = false; is_ws85 = true;
+  ref_read_block(FIXTURE_WS85);
+  bench("ref_read_wsxx WS85 block (incl. idle timeout)", 50, []{ sink += ref_read_block(FIXTURE_WS85); });
+  read_block(FIXTURE_WS85);
+  bench("read_wsxx WS85 block (incl. idle timeout)", 50, []{ sink += read_block(FIXTURE_WS85); });
+
+  // Scheduling ----------------------------------------------------------------------------------------------------------------------
+  tasks_init();
+  task_register(TASK_WEATHER, task_log<TASK_WEATHER>, broadcast_interval_weather, TASK_SCALED | TASK_RADIO | TASK_WAKE);
+  task_register(TASK_NAME, task_log<TASK_NAME>, broadcast_interval_name, TASK_SCALED | TASK_RADIO | TASK_WAKE);
+  task_register(TASK_BARO, task_log<TASK_BARO>, 0, 0);
+  task_register(TASK_SETTINGS, task_log<TASK_SETTINGS>, 15000, 0);
+  task_schedule(TASK_WEATHER, sim_time + 28000);
+  task_schedule(TASK_NAME, sim_time + 250000);
+  task_schedule(TASK_BARO, sim_time + 10);
+  task_schedule(TASK_SETTINGS, sim_time + 15000);
+  last_fnet_send = sim_time - 12000;
+  bench("calc_time_to_sleep", 1000000, []{ sink += calc_time_to_sleep(); });
+  bench("tasks_run (nothing due)", 1000000, []{ tasks_run(); sink += task_heap_len; });
+
+  // Baro compensation ----------------------------------------------------------------------------------------------------------------------
+  static BMP280 bmp;
+  const uint8_t cal[24] = {0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC, 0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B, 0x27, 0x0B, 0x8C, 0x00, 0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17};
+  bmp.setCalibration(cal);
+  bench("BMP280 calcTemperature+calcPressure (double)", 1000000, []{
+    double T, P, uT = 519888 + (rng() & 0xFF), uP = 415148 + (rng() & 0xFF);
+    bmp.calcTemperature(T, uT);
+    bmp.calcPressure(P, uP);
+    sink += (uint32_t)P;
+  });
+  bench("BMP280 compensateTemperature+Pressure (int)", 1000000, []{
+    sink += bmp.compensateTemperature(519888 + (rng() & 0xFF));
+    sink += bmp.compensatePressure(415148 + (rng() & 0xFF));
+  });
+
+  return ok ? 0 : 1;
+}
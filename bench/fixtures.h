@@ -0,0 +1,161 @@
+#pragma once
+// Sensor output blocks captured from real stations (see the dumps at the end of src/main.cpp), CRLF line endings as sent on the UART
+
+// WS85 Ver:1.0.7
+static const char FIXTURE_WS85[] =
+  "========== WS85 Ver:1.0.7 ===========\r\n"
+  ">> g_RrFreqSel = 868M\r\n"
+  ">> Device_ID  = 0x002794\r\n"
+  "-------------------------------------\r\n"
+  "WindDir      = 76\r\n"
+  "WindSpeed    = 0.5\r\n"
+  "WindGust     = 0.6\r\n"
+  "GXTS04Temp   = 24.4\r\n"
+  "\r\n"
+  "UltSignalRssi  = 2\r\n"
+  "UltStatus      = 0\r\n"
+  "SwitchCnt      = 0\r\n"
+  "RainIntSum     = 0\r\n"
+  "Rain           = 0.0\r\n"
+  "WaveCnt[CH1]   = 0\r\n"
+  "WaveCnt[CH2]   = 0\r\n"
+  "WaveRain       = 0\r\n"
+  "ToaltWave[CH1] = 0\r\n"
+  "ToaltWave[CH2] = 0\r\n"
+  "ResAdcCH1      = 4095\r\n"
+  "ResAdcSloCH1   = 0.0\r\n"
+  "ResAdcCH2      = 4095\r\n"
+  "ResAdcSloCH2   = 0.0\r\n"
+  "CapVoltage     = 0.80V\r\n"
+  "BatVoltage     = 3.26V\r\n"
+  "=====================================\r\n"
+  ;
+
+// WH80 Ver:1.2.8
+static const char FIXTURE_WS80[] =
+  "========== WH80 Ver:1.2.8 ===========\r\n"
+  ">> RF_FreqSel = 868M\r\n"
+  ">> Device_ID  = 0x70014\r\n"
+  "-------------------------------------\r\n"
+  "WindDir      = 63\r\n"
+  "WindSpeed    = 0.6\r\n"
+  "WindGust     = 0.6\r\n"
+  "\r\n"
+  "-------SHT30--------\r\n"
+  "Temperature  = 20.7\r\n"
+  "Humi         = 56%\r\n"
+  "\r\n"
+  "-------Si1132-------\r\n"
+  "Light        = 150 lux\r\n"
+  "\r\n"
+  "UV_Value     = 0.0\r\n"
+  "\r\n"
+  "Not Detected Pressure Sensor!\r\n"
+  "Pressure     = --\r\n"
+  "\r\n"
+  "BatVoltage      = 3.26V\r\n"
+  "=====================================\r\n"
+  ;
+
+// WH80 Ver:1.2.5, extended output with the ultrasonic diagnostics that follow the measurement block
+static const char FIXTURE_WS80_EXT[] =
+  "========== WH80 Ver:1.2.5 ===========\r\n"
+  ">> RF_FreqSel = 868M\r\n"
+  ">> Device_ID  = 0x00048\r\n"
+  "-------------------------------------\r\n"
+  "WindDir      = 338\r\n"
+  "WindSpeed    = 0.0\r\n"
+  "WindGust     = 0.8\r\n"
+  "\r\n"
+  "-------SHT40--------\r\n"
+  "Temperature  = 24.3\r\n"
+  "Humi         = 57%\r\n"
+  "\r\n"
+  "-------Si1132-------\r\n"
+  "Light        = 2630 lux\r\n"
+  "UV_Value     = 0.2\r\n"
+  "\r\n"
+  "Not Detected Pressure Sensor!\r\n"
+  "Pressure     = --\r\n"
+  "\r\n"
+  "BatVoltage      = 2.60V\r\n"
+  "=====================================\r\n"
+  "\r\n"
+  "=====================================\r\n"
+  "max = 787, min = 783\r\n"
+  "max -min = 4\r\n"
+  "max = 786, min = 783\r\n"
+  "max -min = 3\r\n"
+  "max = 788, min = 783\r\n"
+  "max -min = 5\r\n"
+  "max = 787, min = 785\r\n"
+  "max -min = 2\r\n"
+  "------------------\r\n"
+  "CH_1 mag. normal\r\n"
+  "CH_2 mag. normal\r\n"
+  "CH_3 mag. normal\r\n"
+  "CH_4 mag. normal\r\n"
+  "------------------\r\n"
+  "Vol_CH1_3 = 252\r\n"
+  "Vol_CH3_1 = 262\r\n"
+  "Vol_CH4_2 = 264\r\n"
+  "Vol_CH2_4 = 265\r\n"
+  "SqWave_CH1_3 = 2\r\n"
+  "SqWave_CH3_1 = 2\r\n"
+  "SqWave_CH4_2 = 2\r\n"
+  "SqWave_CH2_4 = 2\r\n"
+  "min_index = 0\r\n"
+  "Min_Voltage = 252\r\n"
+  "absTv0 = 5\r\n"
+  "Source_CH1_3 = 100.00,3200\r\n"
+  "Source_CH3_1 = 99.81,3194\r\n"
+  "Source_CH4_2 = 99.88,3196\r\n"
+  "Source_CH2_4 = 99.56,3186\r\n"
+  "g_UltTimeV01_3 = 99.91,3197\r\n"
+  "datCnt1_3 = 2\r\n"
+  "g_UltTimeV04_2 = 99.72,3191\r\n"
+  "datCnt4_2 = -5\r\n"
+  "x_y = 53\r\n"
+  "Get_Cali_Ult_X = 51778\r\n"
+  "direction = 290\r\n"
+  "wind = 3\r\n"
+  "\r\n"
+  "=====================================\r\n"
+  "max = 787, min = 784\r\n"
+  "max -min = 3\r\n"
+  "max = 784, min = 782\r\n"
+  "max -min = 2\r\n"
+  "max = 787, min = 783\r\n"
+  "max -min = 4\r\n"
+  "max = 789, min = 781\r\n"
+  "max -min = 8\r\n"
+  "------------------\r\n"
+  "CH_1 mag. normal\r\n"
+  "CH_2 mag. normal\r\n"
+  "CH_3 mag. normal\r\n"
+  "CH_4 mag. normal\r\n"
+  "------------------\r\n"
+  "Vol_CH1_3 = 254\r\n"
+  "Vol_CH3_1 = 261\r\n"
+  "Vol_CH4_2 = 263\r\n"
+  "Vol_CH2_4 = 263\r\n"
+  "SqWave_CH1_3 = 2\r\n"
+  "SqWave_CH3_1 = 2\r\n"
+  "SqWave_CH4_2 = 2\r\n"
+  "SqWave_CH2_4 = 2\r\n"
+  "min_index = 0\r\n"
+  "Min_Voltage = 254\r\n"
+  "absTv0 = 5\r\n"
+  "Source_CH1_3 = 100.06,3202\r\n"
+  "Source_CH3_1 = 100.00,3200\r\n"
+  "Source_CH4_2 = 99.91,3197\r\n"
+  "Source_CH2_4 = 99.78,3193\r\n"
+  "g_UltTimeV01_3 = 100.03,3201\r\n"
+  "datCnt1_3 = 6\r\n"
+  "g_UltTimeV04_2 = 99.84,3195\r\n"
+  "datCnt4_2 = 1\r\n"
+  "x_y = 60\r\n"
+  "Get_Cali_Ult_X = 55200\r\n"
+  "direction = 9\r\n"
+  "wind = 4\r\n"
+  ;
@@ -0,0 +1,186 @@
+#pragma once
+// Previous implementations of optimised functions, kept for speed comparison and equivalence checks.
+#include <Arduino.h>
+#include "hist.h"
+#include "wsxx.h"
+
+// full ringbuffer scan with trig per slot, as get_wind_from_hist() did before the running windows
+WindSample ref_get_wind_from_hist(uint32_t age){
+  WindSample ret = {0,0,0,0};
+
+  float y_part = 0;
+  float x_part = 0;
+  int samplecount =0;
+
+  uint8_t p = wind_hist_pos;
+  for( int i = 0; i < WIND_HIST_LEN; i++){
+    if(p == WIND_HIST_LEN){
+      p -= WIND_HIST_LEN;
+    }
+    if( ( wind_history[p].time && (time()- wind_history[p].time) < age)){
+      ret.wind += wind_history[p].wind;
+      ret.gust += wind_history[p].gust;
+      x_part += cos (wind_history[p].dir_raw * M_PI / 180);
+      y_part += sin (wind_history[p].dir_raw * M_PI / 180);
+      samplecount++;
+    }
+    p++;
+  }
+  if(samplecount > 0){
+    ret.dir_raw = atan2 (y_part / samplecount, x_part / samplecount) * 180 / M_PI;
+    if(ret.dir_raw <0){ ret.dir_raw +=360;}
+    ret.wind /= samplecount;
+    ret.gust /= samplecount;
+  }
+  return ret;
+}
+
+void ref_insert_sorted(uint32_t* arr, int arrlen, uint32_t value){
+    if (value <= arr[arrlen - 1]) {
+        return; // value too small, skip
+    }
+    int i = 0;
+    for (i = arrlen - 1; (i >= 0 && arr[i] < value); i--) {
+        arr[i + 1] = arr[i];
+    }
+    arr[i+1] = value;
+}
+
+// top-7 list over a full ringbuffer scan, returning the 5th highest gust
+float ref_get_gust_from_hist(uint32_t age){
+  #define REF_GUSTBUFFERLEN 7
+  uint32_t ret[REF_GUSTBUFFERLEN + 1] = {0,0,0,0,0,0,0,0}; // insert shifts one entry past the list end
+  uint8_t p = wind_hist_pos;
+  for( int i = 0; i < WIND_HIST_LEN; i++){
+    if(p == WIND_HIST_LEN){
+      p -= WIND_HIST_LEN;
+    }
+    if(( wind_history[p].time && (time()- wind_history[p].time) < age)){
+      ref_insert_sorted(ret, REF_GUSTBUFFERLEN, wind_history[p].gust);
+    }
+    p++;
+  }
+  return ret[4]/10.0;
+}
+
+// strcmp chain with atof, as set_value() was before the streaming parser
+bool ref_set_value(char* key,  char* value){
+  //printf("%s = %s\r\n",key, value);
+
+  if(strcmp(key,"WindDir")==0) {wind_dir_raw = atoi(value); add_wind_history_dir(wind_dir_raw); return false;}
+  if(strcmp(key,"WindSpeed")==0) {wind_speed = atof(value)*3.6; add_wind_history_wind(wind_speed); printf("%s = %0.2f\n",key, wind_speed); return false;}
+  if(strcmp(key,"WindGust")==0) {wind_gust = atof(value)*3.6; add_wind_history_gust(wind_gust); printf("%s = %0.2f\n",key, wind_gust); return false;}
+  if(strcmp(key,"Temperature")==0) {temperature = atof(value); if(!is_ws80){is_ws80=true; is_ws85=false; log_i("Detected WS80\n");} return false;} // WS80 only - autodetection
+  if(strcmp(key,"GXTS04Temp")==0) {temperature = atof(value);  if(!is_ws85){is_ws85=true; is_ws80=false; log_i("Detected WS85\n");} return false;} // WS85 only
+  if(strcmp(key,"Humi")==0) {humidity = atoi(value); return false;}
+  if(strcmp(key,"Light")==0) {light_lux = atoi(value); return false;}
+  if(strcmp(key,"UV_Value")==0) {uv_level = atof(value); return false;}
+  if(strcmp(key,"CapVoltage")==0) {cap_voltage = atof(value); return false;} // WS85
+  if(strcmp(key,"BatVoltage")==0) {
+    wsxx_vcc = atof(value); 
+    last_wsxx_data =time();
+    
+    log_i("WSXX data complete\r\n");
+    return true;
+  }
+
+  //log_i(" ->not_found\n");
+  return false;
+}
+
+// strcmp chain over the known keys, as ref_set_value() dispatches
+uint8_t ref_lookup_key(const char* key){
+  for(uint8_t i = 1; i < WSXX_KEY_COUNT; i++){
+    if(strcmp(key, wsxx_keys[i]) == 0){ return i;}
+  }
+  return WSXX_NONE;
+}
+
+// two pass reading: buffer until the UART is idle, then process_line() + ref_set_value(), as read_wsxx() was before the streaming parser
+// 2: data complete
+// 1: error
+// 0: data ok, continue
+int ref_read_wsxx(){
+  #define REF_BUFFERSIZE 1024 // size of linebuffer
+  static char buffer [REF_BUFFERSIZE];
+  int co = 0;
+  bool found_data = false;
+  int eq_count = 0;
+  uint32_t last_data = micros();
+  //uint32_t cpy_last_wsxx_data = last_wsxx_data;
+  static uint32_t serial_wait = 3800;
+
+// Compare String 1
+  char comp1_arr[8] = {"FreqSel"};
+  const int comp1_len = 7;
+  int comp1_pos = 0;
+
+// Compare String 2
+  char comp2_arr[5];
+  if(is_ws85){ sprintf(comp2_arr,"WS85");}
+  else if(is_ws80){ sprintf(comp2_arr,"WH80");}
+  const int comp2_len = 4;
+  int comp2_pos = 0;
+
+  //uint32_t micros_start = micros();
+
+
+  while(micros()- last_data < serial_wait){ //  cpy_last_wsxx_data == last_wsxx_data &&
+    while (WSXX_UART.available()){
+      //led_error(1); // blink LED, for debugging
+      buffer[co] = WSXX_UART.read();
+      if(buffer[co] < 127){ // skip garbage
+        if(buffer[co] == '=') {eq_count++;} else {eq_count =0;}
+
+        if(buffer[co] == comp1_arr[comp1_pos]) {comp1_pos++;} 
+        else {comp1_pos=0;}
+
+        if(buffer[co] == comp2_arr[comp2_pos]) {comp2_pos++;} 
+        else {comp2_pos=0;}
+
+        if((comp1_pos == comp1_len) ||(comp2_pos == comp2_len)){ // if we found or pattern, increase wait time to get full block
+          found_data = true;
+          if(is_ws80){ serial_wait = 500;}
+          else if(is_ws85){ serial_wait = 3800;}
+        }
+
+        last_data = micros();
+        co++;
+
+
+        if(found_data && eq_count > 35) { // block ends with 37x =, if detected, lower wait time
+          serial_wait = 1;
+        }
+        
+        if(co >= REF_BUFFERSIZE){
+          log_e("Buffer size exeeded\r\n");
+          co = 0;
+          //led_error(0);
+          return RESP_ERROR;
+        }
+      }
+    }
+    //led_error(0);
+  }
+
+// now parse buffer content
+if(found_data){
+  int i =0;
+  int pos = 0;
+  while (i < co){
+    if(buffer[i] == '\n'){
+          if(test_with_usb && usb_connected){
+            Serial.write(&buffer[pos], i-pos);
+          }
+          if(process_line(&buffer[pos], i-pos-1, &ref_set_value)){
+            serial_wait = 120; // decrease value if one valid measuremnt was fount to dertimne if it is ws80 or ws85
+            return RESP_COMPLETE;
+          }
+      pos = i+1;
+    }
+    i++;
+
+  }
+}
+  return RESP_OK;
+}
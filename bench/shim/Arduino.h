@@ -0,0 +1,78 @@
+#pragma once
+// Minimal Arduino shim for the host-native bench (env:native).
+// Only what src/hist.h, src/types.h, src/logging.h, src/wsxx.h, src/schedule.h and lib/BMP280 need.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using std::min;
+using std::max;
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// LibPrintf routes printf to the debug UART, here it goes nowhere
+static inline int printf_(const char*, ...) { return 0; }
+#define printf printf_
+
+static inline uint32_t micros(){
+  static const auto t0 = std::chrono::steady_clock::now();
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+static inline uint32_t millis(){ return micros() / 1000; }
+static inline void delay(uint32_t ms){ std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+class String {
+  public:
+    String() {}
+    String(const char* s) : s_(s ? s : "") {}
+    String(const std::string& s) : s_(s) {}
+    String(char c) : s_(1, c) {}
+    String(int v) : s_(std::to_string(v)) {}
+    String(unsigned int v) : s_(std::to_string(v)) {}
+    String(long v) : s_(std::to_string(v)) {}
+    String(unsigned long v) : s_(std::to_string(v)) {}
+    String(double v, int decimals = 2) { char b[32]; snprintf(b, sizeof(b), "%.*f", decimals, v); s_ = b; }
+    const char* c_str() const { return s_.c_str(); }
+    unsigned int length() const { return s_.length(); }
+    String substring(unsigned int from, unsigned int to) const { return from < s_.size() ? String(s_.substr(from, to - from)) : String(); }
+    void replace(const char* find, const char* repl){
+      std::string f(find);
+      for(size_t p = s_.find(f); !f.empty() && p != std::string::npos; p = s_.find(f, p + strlen(repl))){ s_.replace(p, f.size(), repl); }
+    }
+    String& operator+=(const String& o){ s_ += o.s_; return *this; }
+    friend String operator+(const String& a, const String& b){ return String(a.s_ + b.s_); }
+    bool operator==(const String& o) const { return s_ == o.s_; }
+  private:
+    std::string s_;
+};
+
+// Serial stub: output is discarded, RX is whatever the bench feeds in
+class HardwareSerial {
+  public:
+    void begin(uint32_t) {}
+    void end() {}
+    void flush() {}
+    operator bool() const { return true; }
+    int available() { return (int)(rx_.size() - rx_pos_); }
+    int read() { return rx_pos_ < rx_.size() ? (uint8_t)rx_[rx_pos_++] : -1; }
+    void feed(const char* data, size_t len) { rx_.erase(0, rx_pos_); rx_pos_ = 0; rx_.append(data, len); }
+    size_t write(uint8_t) { return 1; }
+    size_t write(const char*, size_t len) { return len; }
+    size_t write(const uint8_t*, size_t len) { return len; }
+    template<typename T> size_t print(T) { return 0; }
+    template<typename T> size_t println(T) { return 0; }
+    size_t println() { return 0; }
+  private:
+    std::string rx_;
+    size_t rx_pos_ = 0;
+};
+
+static HardwareSerial Serial;
+static HardwareSerial Serial1;
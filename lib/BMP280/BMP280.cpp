@@ -5,6 +5,7 @@
 	This library uses I2C connection.
 
 	Uses floating-point equations from BMP280 datasheet.
+	Define BMP280_INT_COMPENSATION to use the 32/64 bit integer equations instead.
 
 	modified by mhafuzul islam
 
@@ -52,19 +53,10 @@ double chipid = 0;
 if(readUInt(0xD0, chipid)){
 	if(chipid != 0x58){return false;}
 	
-	if (    
-		readUInt(0x88, dig_T1) &&
-		readInt(0x8A, dig_T2)  &&
-		readInt(0x8C, dig_T3)  &&
-		readUInt(0x8E, dig_P1) &&
-		readInt(0x90, dig_P2)  &&
-		readInt(0x92, dig_P3)  &&
-		readInt(0x94, dig_P4)  &&
-		readInt(0x96, dig_P5)  &&
-		readInt(0x98, dig_P6)  &&
-		readInt(0x9A, dig_P7)  &&
-		readInt(0x9C, dig_P8)  &&
-		readInt(0x9E, dig_P9)){
+	unsigned char data[24];
+	data[0] = BMP280_REG_CALIBRATION;
+	if (readBytes(data, 24)){
+		setCalibration(data);
 #ifdef _debugSerial
 		Serial.print("dig_T1="); Serial.println(dig_T1,2);
 		Serial.print("dig_T2="); Serial.println(dig_T2,2);
@@ -113,6 +105,30 @@ if(readUInt(0xD0, chipid)){
 return (0);
 }
 
+/*
+**	Set the calibration from the raw register block, for both the double and the integer path.
+**	@param : raw = 24 bytes from 0x88, dig_T1 first
+*/
+void BMP280::setCalibration(const uint8_t *raw)
+{
+	cal_T1 = (uint16_t)(raw[0] | (raw[1] << 8));
+	cal_T2 = (int16_t)(raw[2] | (raw[3] << 8));
+	cal_T3 = (int16_t)(raw[4] | (raw[5] << 8));
+	cal_P1 = (uint16_t)(raw[6] | (raw[7] << 8));
+	cal_P2 = (int16_t)(raw[8] | (raw[9] << 8));
+	cal_P3 = (int16_t)(raw[10] | (raw[11] << 8));
+	cal_P4 = (int16_t)(raw[12] | (raw[13] << 8));
+	cal_P5 = (int16_t)(raw[14] | (raw[15] << 8));
+	cal_P6 = (int16_t)(raw[16] | (raw[17] << 8));
+	cal_P7 = (int16_t)(raw[18] | (raw[19] << 8));
+	cal_P8 = (int16_t)(raw[20] | (raw[21] << 8));
+	cal_P9 = (int16_t)(raw[22] | (raw[23] << 8));
+
+	dig_T1 = cal_T1; dig_T2 = cal_T2; dig_T3 = cal_T3;
+	dig_P1 = cal_P1; dig_P2 = cal_P2; dig_P3 = cal_P3; dig_P4 = cal_P4; dig_P5 = cal_P5;
+	dig_P6 = cal_P6; dig_P7 = cal_P7; dig_P8 = cal_P8; dig_P9 = cal_P9;
+}
+
 /*
 **	Read a signed integer (two bytes) from device
 **	@param : address = register to start reading (plus subsequent register)
@@ -257,6 +273,19 @@ char BMP280::startMeasurment(void)
 		return(0); // or return 0 if there was a problem communicating with the BMP
 }
 
+char BMP280::startNormalMode(void)
+{
+	unsigned char data[2];
+
+	data[0] = BMP280_REG_CONFIG; // config writes are only reliable in sleep mode, so before the mode change
+	data[1] = BMP280_CONFIG_NORMAL;
+	if (!writeBytes(data, 2))
+		return(0);
+	data[0] = BMP280_REG_CONTROL;
+	data[1] = BMP280_COMMAND_NORMAL;
+	return(writeBytes(data, 2));
+}
+
 /*
 **	Get the uncalibrated pressure and temperature value.
 **  @param : uP = stores the uncalibrated pressure value.(20bit)
@@ -290,6 +319,17 @@ char BMP280::getUnPT(double &uP, double &uT)
 	}
 	return(result);
 }
+char BMP280::getUnPT(int32_t &uP, int32_t &uT)
+{
+	unsigned char data[6];
+
+	data[0] = BMP280_REG_RESULT_PRESSURE;
+	if (!readBytes(data, 6))
+		return(0);
+	uP = ((int32_t)data[0] << 12) | ((int32_t)data[1] << 4) | (data[2] >> 4);	//20bit UP
+	uT = ((int32_t)data[3] << 12) | ((int32_t)data[4] << 4) | (data[5] >> 4);	//20bit UT
+	return(1);
+}
 /*
 ** Retrieve temperature and pressure.
 ** @param : T = stores the temperature value in degC.
@@ -297,6 +337,16 @@ char BMP280::getUnPT(double &uP, double &uT)
 */
 char BMP280::getTemperatureAndPressure(double &T,double &P)
 {
+#ifdef BMP280_INT_COMPENSATION
+	int32_t iT;
+	uint32_t iP;
+	char result = getTemperatureAndPressure(iT, iP);
+	if (result == 1){
+		T = iT / 100.0;
+		P = iP / 25600.0;	// Pa*256 to mBar
+	}
+	return (result);
+#else
 	double uT ;
 	double uP;
 	char result = getUnPT(uP,uT);
@@ -316,6 +366,58 @@ char BMP280::getTemperatureAndPressure(double &T,double &P)
 		error = 1;
 	
 	return (9);
+#endif
+}
+/*
+** Retrieve temperature and pressure, integer path. Same range checks and error codes as the double path.
+** @param : T = stores the temperature value in degC*100.
+** @param : P = stores the pressure value in Pa*256.
+*/
+char BMP280::getTemperatureAndPressure(int32_t &T, uint32_t &P)
+{
+	int32_t uT, uP;
+	if (!getUnPT(uP, uT)){
+		error = 1;
+		return (9);
+	}
+	T = compensateTemperature(uT);
+	if (T > 10000 || T < -10000){
+		error = 2;
+		return (9);
+	}
+	P = compensatePressure(uP);
+	if (P > 1200UL*100*256 || P < 800UL*100*256){
+		error = 3;
+		return (9);
+	}
+	return (1);
+}
+
+// Integer compensation from the BMP280 datasheet, section 8.2
+int32_t BMP280::compensateTemperature(int32_t adc_T)
+{
+	int32_t var1 = ((((adc_T >> 3) - ((int32_t)cal_T1 << 1))) * ((int32_t)cal_T2)) >> 11;
+	int32_t var2 = (((((adc_T >> 4) - ((int32_t)cal_T1)) * ((adc_T >> 4) - ((int32_t)cal_T1))) >> 12) * ((int32_t)cal_T3)) >> 14;
+	t_fine_int = var1 + var2;
+	return (t_fine_int * 5 + 128) >> 8;
+}
+
+uint32_t BMP280::compensatePressure(int32_t adc_P)
+{
+	int64_t var1 = ((int64_t)t_fine_int) - 128000;
+	int64_t var2 = var1 * var1 * (int64_t)cal_P6;
+	var2 = var2 + ((var1 * (int64_t)cal_P5) * 131072);
+	var2 = var2 + (((int64_t)cal_P4) * 34359738368LL);
+	var1 = ((var1 * var1 * (int64_t)cal_P3) >> 8) + ((var1 * (int64_t)cal_P2) * 4096);
+	var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)cal_P1) >> 33;
+	if (var1 == 0)
+		return 0; // avoid exception caused by division by zero
+	int64_t p = 1048576 - adc_P;
+	p = (((p * 2147483648LL) - var2) * 3125) / var1;
+	var1 = (((int64_t)cal_P9) * (p >> 13) * (p >> 13)) >> 25;
+	var2 = (((int64_t)cal_P8) * p) >> 19;
+	p = ((p + var1 + var2) >> 8) + (((int64_t)cal_P7) << 4);
+	return (uint32_t)p;
 }
 /*
 ** temperature calculation
@@ -4,6 +4,8 @@
 	This library uses I2C connection.
 
 	Uses floating-point equations from BMP280 datasheet.
+	Define BMP280_INT_COMPENSATION to use the 32/64 bit integer equations instead,
+	double emulation costs thousands of cycles per reading on a CPU without FPU.
 
 	modified by mhafuzul islam
 
@@ -43,6 +45,11 @@ class BMP280
 			// command BMP280 to start a pressure measurement
 			// oversampling: 0 - 3 for oversampling value
 			// returns (number of ms to wait) for success, 0 for fail
+
+		char startNormalMode(void);
+			// let BMP280 measure on its own every second with the IIR filter on,
+			// getTemperatureAndPressure() then returns the latest filtered result without waiting
+			// returns 1 for success, 0 for fail
 		
 		char calcTemperature(double &T, double &uT);
 			// calculation the true temperature from the given uncalibrated Temperature 
@@ -73,6 +80,18 @@ class BMP280
 			
 		char getTemperatureAndPressure(double& T,double& P);
 
+		char getTemperatureAndPressure(int32_t& T,uint32_t& P);
+			// integer path: T in degC*100, P in Pa*256
+
+		int32_t compensateTemperature(int32_t adc_T);
+			// Bosch integer formula, returns degC*100 (5123 = 51.23 degC), updates t_fine for compensatePressure()
+
+		uint32_t compensatePressure(int32_t adc_P);
+			// Bosch 64 bit integer formula, returns Pa*256 (24674867 = 96386.2 Pa), 0 on invalid calibration
+
+		void setCalibration(const uint8_t *raw);
+			// calibration registers 0x88..0x9F as read from the device (24 bytes, little endian)
+
 	private:
 	
 		char readCalibration();
@@ -107,6 +126,8 @@ class BMP280
 		
 		char getUnPT(double &uP, double &uT);	
 			//get uncalibrated UP and UT value.
+
+		char getUnPT(int32_t &uP, int32_t &uT);
 	
 				
 		//int dig_T2 , dig_T3 , dig_T4 , dig_P2 , dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9; 
@@ -114,11 +135,16 @@ class BMP280
 		double dig_T1, dig_T2 , dig_T3 , dig_T4 , dig_P1, dig_P2 , dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9; 
 		short oversampling, oversampling_t;
 		double t_fine;
+		uint16_t cal_T1, cal_P1;
+		int16_t cal_T2, cal_T3, cal_P2, cal_P3, cal_P4, cal_P5, cal_P6, cal_P7, cal_P8, cal_P9;
+		int32_t t_fine_int;
 		char error;
 };
 
 #define BMP280_ADDR 0x76 // 7-bit address
 
+#define	BMP280_REG_CALIBRATION 0x88			// 0x88..0x9F dig_T1..dig_P9
+
 #define	BMP280_REG_CONTROL 0xF4
 #define	BMP280_REG_RESULT_PRESSURE 0xF7			// 0xF7(msb) , 0xF8(lsb) , 0xF9(xlsb) : stores the pressure data.
 #define BMP280_REG_RESULT_TEMPRERATURE 0xFA		// 0xFA(msb) , 0xFB(lsb) , 0xFC(xlsb) : stores the temperature data.
@@ -130,6 +156,9 @@ class BMP280
 #define	BMP280_COMMAND_PRESSURE3 0x31    
 #define	BMP280_COMMAND_PRESSURE4 0x5D    
 #define	BMP280_COMMAND_OVERSAMPLING_MAX 0xF5
+#define	BMP280_COMMAND_NORMAL 0x57			// osrs_t x2, osrs_p x16, normal mode
+#define	BMP280_REG_CONFIG 0xF5
+#define	BMP280_CONFIG_NORMAL 0xB0			// t_sb 1000 ms, IIR filter coefficient 16
 
 
 #endif
@@ -68,6 +68,29 @@ static uint32_t readRegister3(uint8_t i2cAddress, uint8_t reg)
     return (uint32_t)((int32_t)i2cread() << 16) | ((int32_t)i2cread() << 8) | i2cread();
 }
 
+/**************************************************************************/
+/*
+    Reads len bytes after the specified command in one transfer
+*/
+/**************************************************************************/
+static bool readRegisterN(uint8_t i2cAddress, uint8_t reg, uint8_t *data, uint8_t len)
+{
+    Wire.beginTransmission(i2cAddress);
+    i2cwrite((uint8_t)reg);
+    Wire.endTransmission();
+    if (Wire.requestFrom(i2cAddress, len) != len) return false;
+    for (uint8_t i = 0; i < len; i++) data[i] = i2cread();
+    return true;
+}
+
+// 20 bit 2's complement temperature, upper 4 bits don't care
+static float toTemperature(uint32_t raw)
+{
+    int32_t t = raw & 0xFFFFF;
+    if (t & 0x80000) t |= 0xFFF00000;
+    return t / 100.0;
+}
+
 /**************************************************************************/
 /*
         Instantiates a new HP203B class with appropriate properties
@@ -88,6 +111,7 @@ bool HP203B::begin(uint8_t i2cAddress, hpOSR_t osr)
 {
     hp_i2cAddress = i2cAddress;
     hp_osr = osr;
+    hp_osr_max = osr;
     //Wire.begin();
     
      //Reset();
@@ -142,7 +166,7 @@ void HP203B::Measure_Sensor(void)
 }
 
 
-void HP203B::startMeasure()
+uint8_t HP203B::startMeasure()
 {
     // Set Up the Configuration for the Pressure Sensor
     uint8_t command =   
@@ -153,6 +177,50 @@ void HP203B::startMeasure()
     
     // Write the configuration to the Pressure Sensor
     writeRegister(hp_i2cAddress, command);
+    return conversionTime(hp_osr);
+}
+
+/**************************************************************************/
+/*
+        Pressure and temperature conversion time from the datasheet, rounded up
+*/
+/**************************************************************************/
+uint8_t HP203B::conversionTime(hpOSR_t osr)
+{
+    static const uint8_t ms[6] = {132, 66, 33, 17, 9, 5}; // OSR 4096 .. 128
+    return ms[osr >> 2];
+}
+
+hpOSR_t HP203B::osrForBudget(uint32_t ms)
+{
+    uint8_t osr = hp_osr_max;
+    while (osr < OSR_128 && conversionTime((hpOSR_t)osr) > ms) osr += 4;
+    return (hpOSR_t)osr;
+}
+
+/**************************************************************************/
+/*
+        Conversion state from INT_SRC, the ready bits are set without INT_EN
+*/
+/**************************************************************************/
+bool HP203B::dataReady(void)
+{
+    return readSingleRegister(hp_i2cAddress, HP203B_CMD_READ_REG + HP203B_REG_INT_SRC) & HP203B_INT_SRC_PA_RDY;
+}
+
+bool HP203B::busy(void)
+{
+    return !(readSingleRegister(hp_i2cAddress, HP203B_CMD_READ_REG + HP203B_REG_INT_SRC) & HP203B_INT_SRC_DEV_RDY);
+}
+
+bool HP203B::readMeasurement(void)
+{
+    uint8_t data[6];
+    if (!dataReady()) return false;
+    if (!readRegisterN(hp_i2cAddress, HP203B_CMD_READ_PT, data, 6)) return false;
+    hp_sensorData.T = toTemperature(((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2]);
+    hp_sensorData.P = ((((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 8) | data[5]) & 0xFFFFF) / 100.0;
+    return true;
 }
 
 /**************************************************************************/
@@ -191,5 +259,5 @@ void HP203B::Measure_Temperature()
 {
     // Reads the Temperature value
     uint32_t temperature = readRegister3(hp_i2cAddress, HP203B_CMD_READ_T);
-    hp_sensorData.T = temperature /100.0;
+    hp_sensorData.T = toTemperature(temperature);
 }
\ No newline at end of file
@@ -56,6 +56,10 @@
     #define HP203B_REG_INT_DIR                  (0x0E)      // 
     #define HP203B_REG_PARA                     (0x0F)      // Control Register PARA
 
+    #define HP203B_INT_SRC_DEV_RDY              (0x40)      // Device idle, ready for a command
+    #define HP203B_INT_SRC_PA_RDY               (0x20)      // Pressure/altitude result ready
+    #define HP203B_INT_SRC_T_RDY                (0x10)      // Temperature result ready
+
 
 typedef enum
 {
@@ -84,6 +88,7 @@ class HP203B
         // Instance-specific properties
         uint8_t hp_conversionDelay;
         hpOSR_t hp_osr;
+        hpOSR_t hp_osr_max;
 
     public:
         uint8_t hp_i2cAddress;
@@ -91,7 +96,12 @@ class HP203B
         void Reset(void);
         void getAddr_HP203B(uint8_t i2cAddress);
         bool begin(uint8_t i2cAddress, hpOSR_t osr);
-        void startMeasure();
+        uint8_t startMeasure();     // returns the conversion time in ms
+        bool dataReady(void);       // conversion done, result not read yet
+        bool busy(void);            // conversion running
+        bool readMeasurement(void); // pressure and temperature in one burst, false if no result is ready
+        uint8_t conversionTime(hpOSR_t osr);
+        hpOSR_t osrForBudget(uint32_t ms); // highest OSR up to the one given to begin() that converts within ms
         void Measure_Sensor(void);
         void Measure_Pressure(void);
         void Measure_Altitude(void);
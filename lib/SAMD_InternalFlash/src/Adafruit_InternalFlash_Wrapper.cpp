@@ -21,13 +21,16 @@
 
 Adafruit_InternalFlash_Wrapper::Adafruit_InternalFlash_Wrapper() : Adafruit_SPIFlash() 
 {
-  _cache = NULL;
 }
 
 Adafruit_InternalFlash_Wrapper::Adafruit_InternalFlash_Wrapper(Adafruit_FlashTransport_InternalFlash *transport)
     : Adafruit_SPIFlash(transport) 
 {
-  _cache = NULL;
+}
+
+InternalFlash *Adafruit_InternalFlash_Wrapper::storage()
+{
+  return ((Adafruit_FlashTransport_InternalFlash*)_trans)->_flash;
 }
 
 bool Adafruit_InternalFlash_Wrapper::begin(SPIFlash_Device_t const *flash_devs,
@@ -39,16 +42,7 @@ bool Adafruit_InternalFlash_Wrapper::begin(SPIFlash_Device_t const *flash_devs,
 
   _flash_dev = ((Adafruit_FlashTransport_InternalFlash*)_trans)->getFlashDevice();
 
-  // Use cache
-  if (_flash_dev) {
-    // new cache object if not already
-    if (!_cache) {
-      _cache = new Adafruit_FlashCache();
-    }
-  }
-
-  if (((Adafruit_FlashTransport_InternalFlash*)_trans)->_flash==NULL || 
-      ((Adafruit_FlashTransport_InternalFlash*)_trans)->_flash->get_flash_size()<8192)
+  if (storage()==NULL || storage()->get_flash_size()<8192)
   {
     // The internal flash should be allocated and provided and its size 
     // should not be smaller than 8 kB. This is required for the Fat system
@@ -65,27 +59,30 @@ bool Adafruit_InternalFlash_Wrapper::begin(SPIFlash_Device_t const *flash_devs,
 bool Adafruit_InternalFlash_Wrapper::readBlock(uint32_t block, uint8_t *dst) 
 {
   SPIFLASH_LOG(block, 1);
-  return _cache->read(this, block * 512, dst, 512);
+  storage()->read(block * 512, dst, 512);
+  return true;
 }
 
 bool Adafruit_InternalFlash_Wrapper::syncBlocks() {
   SPIFLASH_LOG(0, 0);
-  return _cache->sync(this);
+  storage()->flush_buffer();
+  return true;
 }
 
 bool Adafruit_InternalFlash_Wrapper::writeBlock(uint32_t block, const uint8_t *src) {
   SPIFLASH_LOG(block, 1);
-  return _cache->write(this, block * 512, src, 512);
+  return storage()->program(block * 512, src, 512);
 }
 
 bool Adafruit_InternalFlash_Wrapper::readBlocks(uint32_t block, uint8_t *dst, size_t nb) {
   SPIFLASH_LOG(block, nb);
-  return _cache->read(this, block * 512, dst, 512 * nb);
+  storage()->read(block * 512, dst, 512 * nb);
+  return true;
 }
 
 bool Adafruit_InternalFlash_Wrapper::writeBlocks(uint32_t block, const uint8_t *src,
                                     size_t nb) {
   SPIFLASH_LOG(block, nb);
-  return _cache->write(this, block * 512, src, 512 * nb);
+  return storage()->program(block * 512, src, 512 * nb);
 }
 
@@ -42,12 +42,14 @@
 #endif
 
 class Adafruit_FlashTransport_InternalFlash;
+class InternalFlash;
 
 // This class extends Adafruit_SPIFlashBase by adding support for the
 // BaseBlockDriver interface. This allows it to be used with SdFat's
 // FatFileSystem class.
 //
-// Instances of this class will use 4kB of RAM as a block cache.
+// No block cache: blocks go straight to InternalFlash::program(), which
+// compares against the flash and only erases/writes the rows that changed.
 class Adafruit_InternalFlash_Wrapper : public Adafruit_SPIFlash {
 public:
   Adafruit_InternalFlash_Wrapper();
@@ -63,7 +65,7 @@ public:
   virtual bool readBlocks(uint32_t block, uint8_t *dst, size_t nb);
   virtual bool writeBlocks(uint32_t block, const uint8_t *src, size_t nb);
 private:
-  Adafruit_FlashCache *_cache;
+  InternalFlash *storage();
 };
 
 #endif /* ADAFRUIT_INTERNALFLASH_WRAPPER_H_ */
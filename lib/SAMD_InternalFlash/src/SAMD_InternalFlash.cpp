@@ -29,6 +29,8 @@ extern uint32_t __etext; // CODE END. Symbol exported from linker script
 #define FLASH_NUM_PAGES NVMCTRL->PARAM.bit.NVMP // 64
 #define SAMD_FLASH_SIZE (SAMD_FLASH_PAGE_SIZE * FLASH_NUM_PAGES) // 262144
 #define FLASH_BLOCK_SIZE (SAMD_FLASH_PAGE_SIZE * 16) //65536 0x10000
+#define SAMD21_ROW_SIZE 256 // erase unit
+#define SAMD21_PAGE_SIZE 64 // write unit
 
 
 InternalFlash::InternalFlash(){
@@ -109,6 +111,58 @@ void InternalFlash::read(uint32_t offset, void *data, uint32_t size)
 #endif
 }
 
+bool InternalFlash::program(uint32_t offset, const void *data, uint32_t size)
+{
+#if defined(__SAMD51__)
+  // The buffer erases on flush
+  write(offset, data, size);
+#else
+  const uint8_t *src = (const uint8_t *)data;
+  while (size)
+  {
+    uint32_t row = offset - (offset % SAMD21_ROW_SIZE);
+    uint32_t pos = offset - row;
+    uint32_t n = min(size, (uint32_t)SAMD21_ROW_SIZE - pos);
+    memcpy(_row, (const void *)(_flash_address+row), SAMD21_ROW_SIZE);
+    memcpy(_row+pos, src, n);
+    program_row(row);
+    offset += n;
+    src += n;
+    size -= n;
+  }
+#endif
+  return true;
+}
+
+#if !defined(__SAMD51__)
+void InternalFlash::program_row(uint32_t row)
+{
+  const uint8_t *cur = (const uint8_t *)(_flash_address+row);
+  bool changed = false;
+  for (uint32_t i=0; i<SAMD21_ROW_SIZE; i++)
+  {
+    if (_row[i] == cur[i])
+      continue;
+    changed = true;
+    if (_row[i] & ~cur[i])
+    {
+      // A bit has to go from 0 to 1, only an erase does that
+      fl.erase(cur, SAMD21_ROW_SIZE);
+      break;
+    }
+  }
+  if (!changed)
+    return;
+
+  // Against the current content: after an erase this skips the pages that stay blank
+  for (uint32_t p=0; p<SAMD21_ROW_SIZE; p+=SAMD21_PAGE_SIZE)
+  {
+    if (memcmp(_row+p, cur+p, SAMD21_PAGE_SIZE))
+      fl.write(cur+p, _row+p, SAMD21_PAGE_SIZE);
+  }
+}
+#endif
+
 void InternalFlash::flush_buffer()
 {
 // This is specific to __SAMD51__ since the writing has to be 8192 bytes long
@@ -38,6 +38,10 @@ public:
   void erase(uint32_t offset, uint32_t size);
   void read(uint32_t offset, void *data, uint32_t size);
 
+  // Write that handles the erase itself, per 256 byte row (4 pages of 64 bytes on the SAMD21): unchanged rows are
+  // skipped, rows where only bits go from 1 to 0 are programmed without erase, and only pages that differ are written.
+  bool program(uint32_t offset, const void *data, uint32_t size);
+
   uint32_t get_flash_size() const { return _flash_size;}
   void *get_flash_address() const { return (void*)_flash_address;}
 
@@ -53,6 +57,9 @@ private:
   uint8_t _buff[8192];
   uint32_t _buff_addr;
   bool _buff_in_used;
+#else
+  void program_row(uint32_t row);
+  uint8_t _row[256]; // new content of the row being programmed
 #endif
 };
 
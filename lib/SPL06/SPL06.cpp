@@ -24,14 +24,46 @@ bool SPL06::begin(uint8_t spl_address){
 
 	i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x09, 0x00);	// FIFO Pressure measurement  
   uint8_t prod_id = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x0D);
+  if(prod_id != 0x10){ return false;}
 
-  return prod_id == 0x10;
+  for(uint8_t i = 0; i < 40 && !(get_spl_meas_cfg() & 0x80); i++){ delay(1);} // COEF_RDY, ~40 ms after power on
+  update_scale_factors();
+  return read_coefficients();
 }
 
 uint8_t SPL06::start_measure(){
   return i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x08, 0B0111);	// continuous temp and pressure measurement
 }
 
+// Background mode: the sensor measures on its own at 1 Hz and stores the results in its 32 entry FIFO (~16 s),
+// a wake drains them with read_fifo() without waiting for a conversion.
+uint8_t SPL06::start_background(){
+  i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x08, 0B0000);	// idle while configuring
+  i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x06, 0x03);	// Pressure 8x oversampling, 1 sample/s
+  i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x07, 0x83);	// Temperature 8x oversampling, 1 sample/s
+  i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x09, 0x02);	// FIFO enable
+  i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x0C, 0x80);	// FIFO flush
+  update_scale_factors();
+  return i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x08, 0B0111);	// background pressure and temperature measurement
+}
+
+// Every FIFO entry is read as one 3 byte burst from PSR_B2, bit 0 tells pressure (1) from temperature (0).
+// Averages all entries of each kind, praw/traw are left untouched if there is no entry of that kind.
+uint8_t SPL06::read_fifo(int32_t &praw, int32_t &traw){
+  int32_t p_sum = 0, t_sum = 0; // 32 x 24 bit fits
+  uint8_t p_n = 0, t_n = 0;
+  uint8_t data[3];
+
+  for(uint8_t i = 0; i < 32 && !(get_spl_fifo_sts() & 0x01); i++){ // until FIFO_EMPTY
+    if(i2c_read_bytes(SPL_CHIP_ADDRESS, 0x00, data, 3) != 3){ break;}
+    int32_t v = raw24(data);
+    if(v & 1){ p_sum += v; p_n++;} else { t_sum += v; t_n++;}
+  }
+  if(p_n){ praw = p_sum / p_n;}
+  if(t_n){ traw = t_sum / t_n;}
+  return p_n;
+}
+
 uint8_t SPL06::sleep(){
   return i2c_eeprom_write_uint8_t(SPL_CHIP_ADDRESS, 0x08, 0B0000);	// set to idle mode (1µA)
 }
@@ -94,393 +126,149 @@ double SPL06::get_altitude_f(double pressure, double seaLevelhPa)
 
 double SPL06::get_traw_sc()
 {
-	int32_t traw = get_traw();
-	return (double(traw)/get_temperature_scale_factor());
+	return double(get_traw())/kt;
 }
 
 
 double SPL06::get_temp_c()
 {
-	int16_t c0,c1;
-	c0 = get_c0();
-	c1 = get_c1();
-	double traw_sc = get_traw_sc();
-	return (double(c0) * 0.5f) + (double(c1) * traw_sc);
+	return get_temp_c(get_traw());
 }
 
-
-double SPL06::get_temp_f()
+double SPL06::get_temp_c(int32_t traw)
 {
-	int16_t c0,c1;
-	c0 = get_c0();
-	c1 = get_c1();
-	double traw_sc = get_traw_sc();
-	return (((double(c0) * 0.5f) + (double(c1) * traw_sc)) * 9/5) + 32;
+	return (double(c0) * 0.5f) + (double(c1) * double(traw)/kt);
 }
 
 
-double SPL06::get_temperature_scale_factor()
+double SPL06::get_temp_f()
 {
-  
-  double k;
-
-  uint8_t tmp_Byte;
-  tmp_Byte = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x07); // MSB
-
-  //Serial.print("tmp_Byte: ");
-  //Serial.println(tmp_Byte);
-
-  //tmp_Byte = tmp_Byte >> 4; //Focus on bits 6-4
-  tmp_Byte = tmp_Byte & 0B00000111;
-  //Serial.print("tmp_Byte: ");
-  //Serial.println(tmp_Byte);
-
-  switch (tmp_Byte) 
-  {
-    case 0B000:
-      k = 524288.0;
-    break;
-
-    case 0B001:
-      k = 1572864.0;
-    break;
-
-    case 0B010:
-      k = 3670016.0;
-    break;
-
-    case 0B011:
-      k = 7864320.0;
-    break;
-
-    case 0B100:
-      k = 253952.0;
-    break;
-
-    case 0B101:
-      k = 516096.0;
-    break;
-
-    case 0B110:
-      k = 1040384.0;
-    break;
-
-    case 0B111:
-      k = 2088960.0;
-    break;
-  }
-
-  return k;
+	return (get_temp_c() * 9/5) + 32;
 }
 
 
-int32_t SPL06::get_traw()
-{
-  int32_t tmp;
-  uint8_t tmp_MSB,tmp_LSB,tmp_XLSB;
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x03); // MSB
-
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x04); // LSB
-
-  tmp_XLSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x05); // XLSB
-
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  tmp = (tmp << 8) | tmp_XLSB;
-
-
-  if(tmp & (1 << 23))
-    tmp = tmp | 0xFF000000; // Set left bits to one for 2's complement conversion of negitive number
-  
-  
-  return tmp;
-}
-
-double SPL06::get_praw_sc()
+// compensation scale factor for oversampling rate 0..7 (PRS_CFG/TMP_CFG bits 2-0)
+double SPL06::scale_factor(uint8_t cfg)
 {
-	int32_t praw = get_praw();
-	return (double(praw)/get_pressure_scale_factor());
+	static const double k[8] = {524288.0, 1572864.0, 3670016.0, 7864320.0, 253952.0, 516096.0, 1040384.0, 2088960.0};
+	return k[cfg & 0B00000111];
 }
 
-double SPL06::get_pcomp()
+// read PRS_CFG and TMP_CFG once after every config change instead of on every reading
+void SPL06::update_scale_factors()
 {
-	int32_t c00,c10;
-	int16_t c01,c11,c20,c21,c30;
-	c00 = get_c00();
-	c10 = get_c10();
-	c01 = get_c01();
-	c11 = get_c11();
-	c20 = get_c20();
-	c21 = get_c21();
-	c30 = get_c30();
-	double traw_sc = get_traw_sc();
-	double praw_sc = get_praw_sc();
-	return double(c00) + praw_sc * (double(c10) + praw_sc * (double(c20) + praw_sc * double(c30))) + traw_sc * double(c01) + traw_sc * praw_sc * ( double(c11) + praw_sc * double(c21));
+	uint8_t cfg[2] = {0, 0};
+	i2c_read_bytes(SPL_CHIP_ADDRESS, 0x06, cfg, 2);
+	kp = scale_factor(cfg[0]);
+	kt = scale_factor(cfg[1]);
 }
 
-double SPL06::get_pressure()
+double SPL06::get_temperature_scale_factor()
 {
-	double pcomp = get_pcomp();
-	return pcomp / 100; // convert to mb
+	return kt;
 }
 
 
-
-double SPL06::get_pressure_scale_factor()
+int32_t SPL06::get_traw()
 {
-	double k;
-
-	uint8_t tmp_Byte;
-	tmp_Byte = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x06); // MSB
-
-	tmp_Byte = tmp_Byte & 0B00000111; // Focus on 2-0 oversampling rate 
-
-
-	switch (tmp_Byte) // oversampling rate
-	{
-		case 0B000:
-			k = 524288.0;
-		break;
-
-		case 0B001:
-			k = 1572864.0;
-		break;
-
-		case 0B010:
-			k = 3670016.0;
-		break;
-
-		case 0B011:
-			k = 7864320.0;
-		break;
-
-		case 0B100:
-			k = 253952.0;
-		break;
-
-		case 0B101:
-			k = 516096.0;
-		break;
-
-		case 0B110:
-			k = 1040384.0;
-		break;
-
-		case 0B111:
-			k = 2088960.0;
-		break;
-	}
-
-	return k;
+	uint8_t data[3];
+	i2c_read_bytes(SPL_CHIP_ADDRESS, 0x03, data, 3);
+	return raw24(data);
 }
 
-
-
-
-int32_t SPL06::get_praw()
+// pressure and temperature in one 6 byte burst
+bool SPL06::read_raw(int32_t &praw, int32_t &traw)
 {
-  int32_t tmp;
-  uint8_t tmp_MSB,tmp_LSB,tmp_XLSB;
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x00); // MSB
-
-
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x01); // LSB
-
-
-  tmp_XLSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x02); // XLSB
-
-  
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  tmp = (tmp << 8) | tmp_XLSB;
-
-
-
-  if(tmp & (1 << 23))
-    tmp = tmp | 0xFF000000; // Set left bits to one for 2's complement conversion of negitive number
-  
-  
-  return tmp;
+	uint8_t data[6];
+	if(i2c_read_bytes(SPL_CHIP_ADDRESS, 0x00, data, 6) != 6){ return false;}
+	praw = raw24(data);
+	traw = raw24(data + 3);
+	return true;
 }
 
-int16_t SPL06::get_c0()
+int32_t SPL06::raw24(const uint8_t* data)
 {
-  int16_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x10); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x11); 
-
-
-
-  tmp_LSB = tmp_LSB >> 4;
-
-
-  tmp = (tmp_MSB << 4) | tmp_LSB;
-
-  if(tmp & (1 << 11)) // Check for 2's complement negative number
-    tmp = tmp | 0xF000; // Set left bits to one for 2's complement conversion of negitive number
-  
-  return tmp;
+	int32_t tmp = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+	if(tmp & (1 << 23))
+		tmp = tmp | 0xFF000000; // Set left bits to one for 2's complement conversion of negitive number
+	return tmp;
 }
 
-
-int16_t SPL06::get_c1()
+double SPL06::get_praw_sc()
 {
-  int16_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x11); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x12); 
-
-
-  tmp_MSB = tmp_MSB & 0xF;
-
-
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-
-  if(tmp & (1 << 11)) // Check for 2's complement negative number
-    tmp = tmp | 0xF000; // Set left bits to one for 2's complement conversion of negitive number
-  
-  return tmp;
+	return double(get_praw())/kp;
 }
 
-int32_t SPL06::get_c00()
+double SPL06::get_pcomp()
 {
-  /*
-  int32_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB,tmp_XLSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x13); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x14); 
-  tmp_XLSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x15);
-
-
-  
-  tmp_XLSB = tmp_XLSB >> 4;
-
-   
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  tmp = (tmp << 4) | tmp_XLSB;
-
-  tmp = (uint32_t)tmp_MSB << 12 | (uint32_t)tmp_LSB << 4 | (uint32_t)tmp_XLSB >> 4;
-
-  if(tmp & (1 << 19))
-    tmp = tmp | 0xFFF00000; // Set left bits to one for 2's complement conversion of negitive number
-    
-
-  return tmp;
-  */
-  int32_t tmp;
-  uint8_t tmp_MSB,tmp_LSB,tmp_XLSB;
-
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x13);
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x14);
-  tmp_XLSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x15);
-  tmp = (tmp_MSB & 0x80 ? 0xFFF00000 : 0) | ((uint32_t)tmp_MSB << 12) | ((uint32_t)tmp_LSB << 4) | (((uint32_t)tmp_XLSB & 0xF0) >> 4);
-  return tmp;
+	int32_t praw, traw;
+	if(!read_raw(praw, traw)){ return 0;}
+	return get_pcomp(praw, traw);
 }
 
-int32_t SPL06::get_c10()
+double SPL06::get_pcomp(int32_t praw, int32_t traw)
 {
-  /*
-  int32_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB,tmp_XLSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x15); // 4 bits
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x16); // 8 bits
-  tmp_XLSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x17); // 8 bits
-
-
-  tmp_MSB = tmp_MSB & 0b00001111;
-
-
-
-  tmp = (tmp_MSB << 4) | tmp_LSB;
-  tmp = (tmp << 8) | tmp_XLSB;
-
-
-
-  tmp = (uint32_t)tmp_MSB << 16 | (uint32_t)tmp_LSB << 8 | (uint32_t)tmp_XLSB;
-
-  if(tmp & (1 << 19))
-    tmp = tmp | 0xFFF00000; // Set left bits to one for 2's complement conversion of negitive number
-
-  return tmp;
-  */
-  
-  int32_t tmp;
-  uint8_t tmp_MSB,tmp_LSB,tmp_XLSB;
-
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x15); // 4 bits
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x16); // 8 bits
-  tmp_XLSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x17); // 8 bits
-  tmp = (tmp_MSB & 0x8 ? 0xFFF00000 : 0) | (((uint32_t)tmp_MSB & 0x0F) << 16) | ((uint32_t)tmp_LSB << 8) | (uint32_t)tmp_XLSB;
-  return tmp;
+	double traw_sc = double(traw)/kt;
+	double praw_sc = double(praw)/kp;
+	return double(c00) + praw_sc * (double(c10) + praw_sc * (double(c20) + praw_sc * double(c30))) + traw_sc * double(c01) + traw_sc * praw_sc * ( double(c11) + praw_sc * double(c21));
 }
 
-
-
-int16_t SPL06::get_c01()
+double SPL06::get_pressure()
 {
-  int16_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x18); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x19); 
-
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  return tmp;
+	double pcomp = get_pcomp();
+	return pcomp / 100; // convert to mb
 }
 
-int16_t SPL06::get_c11()
+double SPL06::get_pressure(int32_t praw, int32_t traw)
 {
-  int16_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x1A); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x1B); 
-
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  return tmp;
+	return get_pcomp(praw, traw) / 100; // convert to mb
 }
 
-int16_t SPL06::get_c20()
-{
-  int16_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x1C); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x1D); 
 
-
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  return tmp;
+double SPL06::get_pressure_scale_factor()
+{
+	return kp;
 }
 
-int16_t SPL06::get_c21()
-{
-  int16_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x1E); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x1F); 
 
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  return tmp;
+int32_t SPL06::get_praw()
+{
+	uint8_t data[3];
+	i2c_read_bytes(SPL_CHIP_ADDRESS, 0x00, data, 3);
+	return raw24(data);
 }
 
-int16_t SPL06::get_c30()
+// Calibration coefficients 0x10..0x21 in one 18 byte burst, they don't change after power on
+bool SPL06::read_coefficients()
 {
-  int16_t tmp; 
-  uint8_t tmp_MSB,tmp_LSB;
-  
-  tmp_MSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x20); 
-  tmp_LSB = i2c_eeprom_read_uint8_t(SPL_CHIP_ADDRESS, 0x21); 
-
-  tmp = (tmp_MSB << 8) | tmp_LSB;
-  return tmp;
-  Serial.print("tmp: ");
-  Serial.println(tmp);
-}
+	uint8_t b[18];
+	if(i2c_read_bytes(SPL_CHIP_ADDRESS, 0x10, b, 18) != 18){ return false;}
+
+	c0 = ((uint16_t)b[0] << 4) | (b[1] >> 4);
+	if(c0 & (1 << 11)) c0 = c0 | 0xF000; // 12 bit 2's complement
+	c1 = (((uint16_t)b[1] & 0x0F) << 8) | b[2];
+	if(c1 & (1 << 11)) c1 = c1 | 0xF000;
+	c00 = ((uint32_t)b[3] << 12) | ((uint32_t)b[4] << 4) | (b[5] >> 4);
+	if(c00 & (1 << 19)) c00 = c00 | 0xFFF00000; // 20 bit 2's complement
+	c10 = (((uint32_t)b[5] & 0x0F) << 16) | ((uint32_t)b[6] << 8) | b[7];
+	if(c10 & (1 << 19)) c10 = c10 | 0xFFF00000;
+	c01 = ((uint16_t)b[8] << 8) | b[9];
+	c11 = ((uint16_t)b[10] << 8) | b[11];
+	c20 = ((uint16_t)b[12] << 8) | b[13];
+	c21 = ((uint16_t)b[14] << 8) | b[15];
+	c30 = ((uint16_t)b[16] << 8) | b[17];
+	return true;
+}
+
+int16_t SPL06::get_c0(){ return c0;}
+int16_t SPL06::get_c1(){ return c1;}
+int32_t SPL06::get_c00(){ return c00;}
+int32_t SPL06::get_c10(){ return c10;}
+int16_t SPL06::get_c01(){ return c01;}
+int16_t SPL06::get_c11(){ return c11;}
+int16_t SPL06::get_c20(){ return c20;}
+int16_t SPL06::get_c21(){ return c21;}
+int16_t SPL06::get_c30(){ return c30;}
 
 uint8_t SPL06::i2c_eeprom_write_uint8_t(  uint8_t deviceaddress, uint8_t eeaddress, uint8_t data ) 
 {
@@ -505,3 +293,15 @@ uint8_t SPL06::i2c_eeprom_read_uint8_t(  uint8_t deviceaddress, uint8_t eeaddres
     if (Wire.available()) rdata = Wire.read();
     return rdata;
 }
+
+uint8_t SPL06::i2c_read_bytes(  uint8_t deviceaddress, uint8_t eeaddress, uint8_t* data, uint8_t len )
+{
+    uint8_t n = 0;
+    Wire.beginTransmission(deviceaddress);
+    Wire.write(eeaddress);
+    Wire.endTransmission(false); // false to not release the line
+
+    Wire.requestFrom(deviceaddress, len);
+    while (Wire.available() && n < len) data[n++] = Wire.read();
+    return n;
+}
@@ -10,6 +10,8 @@ class SPL06
 
 	bool begin(uint8_t spl_address=0x76);
     uint8_t start_measure();
+    uint8_t start_background();	// 1 Hz pressure and temperature into the FIFO, see read_fifo(), 0 = ok
+    uint8_t read_fifo(int32_t &praw, int32_t &traw);	// drain FIFO, returns number of pressure results averaged
     uint8_t sleep();
 
     uint8_t get_spl_id();		// Get ID Register 		0x0D
@@ -26,14 +28,18 @@ class SPL06
     int32_t get_traw();
     double get_traw_sc();
     double get_temp_c();
+    double get_temp_c(int32_t traw);
     double get_temp_f();
     double get_temperature_scale_factor();
 
     int32_t get_praw();
+    bool read_raw(int32_t &praw, int32_t &traw);	// pressure and temperature in one burst
     double get_praw_sc();
     double get_pcomp();
+    double get_pcomp(int32_t praw, int32_t traw);
     double get_pressure_scale_factor();
     double get_pressure();
+    double get_pressure(int32_t praw, int32_t traw);
 
     int16_t get_c0();
     int16_t get_c1();
@@ -47,6 +53,18 @@ class SPL06
 
     uint8_t i2c_eeprom_write_uint8_t(  uint8_t deviceaddress, uint8_t eeaddress, uint8_t data );
     uint8_t i2c_eeprom_read_uint8_t(  uint8_t deviceaddress, uint8_t eeaddress );
+    uint8_t i2c_read_bytes(  uint8_t deviceaddress, uint8_t eeaddress, uint8_t* data, uint8_t len );
+
+	private:
+    bool read_coefficients();
+    void update_scale_factors();
+    static double scale_factor(uint8_t cfg);
+    static int32_t raw24(const uint8_t* data);
+
+    // cached at begin(), scale factors on every config change
+    int16_t c0 = 0, c1 = 0, c01 = 0, c11 = 0, c20 = 0, c21 = 0, c30 = 0;
+    int32_t c00 = 0, c10 = 0;
+    double kp = 7864320.0, kt = 7864320.0; // 8x oversampling
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "dma.h"
+
+// Peripheral -> RAM with DMAC channels, one beat per trigger:
+//   SERCOM0 (Serial1, WSXX sensor) RX, single block, the caller polls the count between idle sleeps.
+//   TC3 capture (Davis pulse intervals), circular block that keeps running in standby.
+// No DMAC interrupt is used. That way it does not collide with libraries that own DMAC_Handler (Adafruit_ZeroDMA):
+// if the DMAC is already running, its descriptor tables are shared and the last channels are used.
+
+#define DMA_SLOT_UART 0
+#define DMA_SLOT_CAPTURE 1
+#define DMA_SLOTS 2
+
+#ifdef DMAC_CHCTRLA_RUNSTDBY
+#define DMA_CAPTURE_CTRLA DMAC_CHCTRLA_RUNSTDBY
+#else // not in every SAMD21 CMSIS version
+#define DMA_CAPTURE_CTRLA 0
+#endif
+
+static DmacDescriptor dma_descriptor[DMA_SLOTS] __attribute__((aligned(16)));
+static DmacDescriptor dma_writeback[DMA_SLOTS] __attribute__((aligned(16)));
+static DmacDescriptor* dma_desc[DMA_SLOTS];
+static DmacDescriptor* dma_wb[DMA_SLOTS];
+static uint8_t dma_ch[DMA_SLOTS];
+static uint16_t dma_len[DMA_SLOTS];
+static bool dma_owner = false; // DMAC was enabled by us, disable it again when the last channel stops
+static uint8_t dma_active = 0; // running slots, bit mask
+
+static void dma_begin(uint8_t slot){
+  PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+  PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+
+  if(!DMAC->CTRL.bit.DMAENABLE){ // unused, our tables
+    dma_owner = true;
+    DMAC->BASEADDR.reg = (uint32_t)dma_descriptor;
+    DMAC->WRBADDR.reg = (uint32_t)dma_writeback;
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+  } else if(!dma_active){ // already set up by another library, share its tables
+    dma_owner = false;
+  }
+  dma_ch[slot] = dma_owner ? slot : DMAC_CH_NUM - 1 - slot;
+  dma_desc[slot] = (DmacDescriptor*)DMAC->BASEADDR.reg + dma_ch[slot];
+  dma_wb[slot] = (DmacDescriptor*)DMAC->WRBADDR.reg + dma_ch[slot];
+  dma_active |= 1 << slot;
+}
+
+static void dma_channel_enable(uint8_t slot, uint8_t trigsrc, uint32_t ctrla){
+  noInterrupts(); // CHID is shared with DMAC_Handler of other libraries
+  DMAC->CHID.reg = DMAC_CHID_ID(dma_ch[slot]);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+  while(DMAC->CHCTRLA.bit.SWRST){};
+  DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) |
+                      DMAC_CHCTRLB_TRIGSRC(trigsrc) |
+                      DMAC_CHCTRLB_TRIGACT_BEAT;
+  DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+  DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE | ctrla;
+  interrupts();
+}
+
+// beats left in the current block
+static uint16_t dma_remaining(uint8_t slot){
+  uint16_t remaining;
+  noInterrupts();
+  DMAC->CHID.reg = DMAC_CHID_ID(dma_ch[slot]);
+  if(DMAC->ACTIVE.bit.ABUSY && DMAC->ACTIVE.bit.ID == dma_ch[slot]){ // beat in progress, write-back is not updated yet
+    remaining = DMAC->ACTIVE.bit.BTCNT;
+  } else {
+    remaining = dma_wb[slot]->BTCNT.reg;
+  }
+  interrupts();
+  return remaining;
+}
+
+static void dma_end(uint8_t slot){
+  noInterrupts();
+  DMAC->CHID.reg = DMAC_CHID_ID(dma_ch[slot]);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  while(DMAC->CHCTRLA.bit.ENABLE){};
+  DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+  interrupts();
+  dma_active &= ~(1 << slot);
+
+  if(dma_owner && !dma_active){ // no one else uses the DMAC, switch it off
+    DMAC->CTRL.reg = 0;
+    PM->AHBMASK.reg &= ~PM_AHBMASK_DMAC;
+    PM->APBBMASK.reg &= ~PM_APBBMASK_DMAC;
+  }
+}
+
+void dma_uart_rx_start(uint8_t* buffer, uint16_t len){
+  dma_begin(DMA_SLOT_UART);
+  DmacDescriptor *d = dma_desc[DMA_SLOT_UART];
+  dma_len[DMA_SLOT_UART] = len;
+  d->BTCTRL.reg = DMAC_BTCTRL_VALID |              // Descriptor is valid
+                  DMAC_BTCTRL_BEATSIZE_BYTE |      // One byte per beat
+                  DMAC_BTCTRL_DSTINC |             // Increment destination, source is the DATA register
+                  DMAC_BTCTRL_BLOCKACT_NOACT;      // Channel is disabled when the buffer is full
+  d->BTCNT.reg = len;
+  d->SRCADDR.reg = (uint32_t)&SERCOM0->USART.DATA.reg;
+  d->DSTADDR.reg = (uint32_t)(buffer + len);       // with DSTINC the end address of the block
+  d->DESCADDR.reg = 0;                             // single block
+  dma_wb[DMA_SLOT_UART]->BTCNT.reg = len;          // nothing received yet
+
+  SERCOM0->USART.INTENCLR.reg = SERCOM_USART_INTENCLR_RXC; // bytes go to the DMA, not to the Uart ringbuffer
+  dma_channel_enable(DMA_SLOT_UART, SERCOM0_DMAC_ID_RX, 0); // Trigger on SERCOM0 RXC
+}
+
+// bytes written to the buffer so far
+uint16_t dma_uart_rx_count(){
+  bool full;
+  noInterrupts();
+  DMAC->CHID.reg = DMAC_CHID_ID(dma_ch[DMA_SLOT_UART]);
+  full = DMAC->CHINTFLAG.bit.TCMPL; // block complete, buffer full
+  interrupts();
+  return dma_len[DMA_SLOT_UART] - (full ? 0 : dma_remaining(DMA_SLOT_UART));
+}
+
+void dma_uart_rx_stop(){
+  dma_end(DMA_SLOT_UART);
+  SERCOM0->USART.INTENSET.reg = SERCOM_USART_INTENSET_RXC; // back to the Uart ringbuffer
+}
+
+void dma_capture_start(volatile void* src, uint8_t trigsrc, uint16_t* ring, uint16_t len){
+  dma_begin(DMA_SLOT_CAPTURE);
+  DmacDescriptor *d = dma_desc[DMA_SLOT_CAPTURE];
+  dma_len[DMA_SLOT_CAPTURE] = len;
+  d->BTCTRL.reg = DMAC_BTCTRL_VALID |
+                  DMAC_BTCTRL_BEATSIZE_HWORD |     // 16 bit capture register
+                  DMAC_BTCTRL_DSTINC |
+                  DMAC_BTCTRL_BLOCKACT_NOACT;
+  d->BTCNT.reg = len;
+  d->SRCADDR.reg = (uint32_t)src;
+  d->DSTADDR.reg = (uint32_t)(ring + len);
+  d->DESCADDR.reg = (uint32_t)d;                   // linked to itself: ring buffer
+  dma_wb[DMA_SLOT_CAPTURE]->BTCNT.reg = len;
+  dma_channel_enable(DMA_SLOT_CAPTURE, trigsrc, DMA_CAPTURE_CTRLA);
+}
+
+// ring index the next capture goes to, wrapped if the block completed at least once
+uint16_t dma_capture_pos(bool *wrapped){
+  uint16_t len = dma_len[DMA_SLOT_CAPTURE];
+  noInterrupts();
+  DMAC->CHID.reg = DMAC_CHID_ID(dma_ch[DMA_SLOT_CAPTURE]);
+  *wrapped = DMAC->CHINTFLAG.bit.TCMPL; // set on every block end, the interrupt itself is not enabled
+  interrupts();
+  return (len - dma_remaining(DMA_SLOT_CAPTURE)) % len;
+}
+
+void dma_capture_stop(){
+  dma_end(DMA_SLOT_CAPTURE);
+}
@@ -0,0 +1,14 @@
+#ifndef DMA_H
+#define DMA_H
+
+#include <Arduino.h>
+
+void dma_uart_rx_start(uint8_t* buffer, uint16_t len);
+uint16_t dma_uart_rx_count();
+void dma_uart_rx_stop();
+
+void dma_capture_start(volatile void* src, uint8_t trigsrc, uint16_t* ring, uint16_t len);
+uint16_t dma_capture_pos(bool *wrapped);
+void dma_capture_stop();
+
+#endif
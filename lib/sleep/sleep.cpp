@@ -1,4 +1,5 @@
 #include "sleep.h"
+#include "dma.h"
 #include "wiring_private.h"
 
 
@@ -283,6 +284,16 @@ void deepsleep(bool light) {
 // https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-42248-SAM-D20-Power-Measurements_ApplicationNote_AT04188.pdf
 }
 
+// Idle0: only the CPU clock stops, peripherals and DMA keep running. SysTick stays enabled and wakes us at the next tick,
+// no flash power up issue as in deepsleep
+void idlesleep(){
+  PM->SLEEP.reg = PM_SLEEP_IDLE_CPU;
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+  __DSB();
+  __WFI();
+  SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk; // keep deepsleep as default, as set by rtc_sleep_cfg()
+}
+
 void PM_sleep(){
   PM->APBCMASK.reg &= ~PM_APBCMASK_ADC;
   PM->APBCMASK.reg &= ~PM_APBBMASK_DMAC;
@@ -472,6 +483,50 @@ void stop_pulse_counter(){
   while (TC4->COUNT16.STATUS.bit.SYNCBUSY);            // Wait for synchronization
 }
 
+// Pulse interval capture, after setup_pulse_counter(): the same EIC event restarts TC3 and captures the ticks (1024Hz)
+// since the previous pulse in CC0, the DMAC copies every capture into the ring. Runs in standby, no CPU wakeup per pulse.
+// One-shot: TC3 stops at overflow (64s without a pulse), the next capture is 0 then.
+void setup_pulse_capture(uint16_t *ring, uint16_t len){
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN |        // Enable the generic clock...
+                      GCLK_CLKCTRL_GEN_GCLK6 |    // On GCLK6 at 1024Hz
+                      GCLK_CLKCTRL_ID_TCC2_TC3;   // Route GCLK6 to TCC2 and TC3
+  while (GCLK->STATUS.bit.SYNCBUSY);
+
+  PM->APBCMASK.reg |= PM_APBCMASK_TC3;
+
+  EVSYS->USER.reg = EVSYS_USER_CHANNEL(1) |                               // Second user of channel 0 (n + 1)
+                    EVSYS_USER_USER(EVSYS_ID_USER_TC3_EVU);
+
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+  while (TC3->COUNT16.CTRLA.bit.SWRST);
+
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 |
+                           TC_CTRLA_RUNSTDBY |
+                           TC_CTRLA_PRESCALER_DIV1 |
+                           TC_CTRLA_PRESCSYNC_GCLK;
+  TC3->COUNT16.CTRLC.reg = TC_CTRLC_CPTEN0;                // CC0 captures
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+  TC3->COUNT16.EVCTRL.reg = TC_EVCTRL_TCEI |
+                            TC_EVCTRL_EVACT_PPW;           // Period to CC0, restart the count
+  TC3->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+
+  dma_capture_start(&TC3->COUNT16.CC[0].reg, TC3_DMAC_ID_MC_0, ring, len); // MC0 request is cleared by the DMA read
+
+  TC3->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+// stops the capture, returns the ring index the next capture would have gone to; wrapped: the ring was filled at least once
+uint16_t read_pulse_capture(bool *wrapped){
+  TC3->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+  uint16_t pos = dma_capture_pos(wrapped);
+  dma_capture_stop();
+  PM->APBCMASK.reg &= ~PM_APBCMASK_TC3;
+  return pos;
+}
+
 
 
  // https://forum.arduino.cc/t/samd21-not-waking-up-using-timer-interrupt-from-deep-sleep/662100/2
@@ -6,6 +6,7 @@
 void pinDisable(uint32_t pin);
 void configGCLK6(bool en_rtc);
 void deepsleep(bool light);
+void idlesleep();
 
 int wdt_enable(int maxPeriodMS, bool isForSleep);
 uint32_t rtc_sleep_cfg(uint32_t milliseconds);
@@ -22,6 +23,8 @@ void setup_pulse_counter();
 uint32_t read_pulse_counter();
 void reset_pulse_counter();
 void stop_pulse_counter();
+void setup_pulse_capture(uint16_t *ring, uint16_t len);
+uint16_t read_pulse_capture(bool *wrapped);
 
 void setup_rtc_time_counter();
 uint32_t read_time_counter();
@@ -0,0 +1,162 @@
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+#include <BMP280.h>
+#include <HP203B.h> // https://github.com/ncdcommunity/Arduino_Library_HP203B_Barometer_Altimeter_Sensor/tree/master
+#include <SPL06.h>
+#include <Adafruit_BMP3XX.h>
+
+// Barometers behind one asynchronous interface: start() a conversion, poll ready(), fetch() the result. Nothing blocks
+// for the conversion, baro_start_reading() queues TASK_BARO at start() + conversion_ms(), so radio TX and the WSXX
+// reception run meanwhile. Sensors that sample on their own (SPL06 FIFO, BMP280 normal mode) or convert during sleep
+// (HP203B pipelined) have conversion_ms() 0 and are ready right at wake.
+
+extern uint32_t time();
+
+class BaroDriver {
+  public:
+    virtual bool begin() = 0; // probe and configure, false if not found
+    virtual void start() = 0; // request a result
+    virtual bool ready() = 0; // fetch() won't wait
+    virtual bool fetch(float &P, float &T) = 0; // hPa, °C, false on no/invalid data
+    virtual uint16_t conversion_ms() = 0; // start() to ready()
+    virtual const char* name() = 0;
+    uint16_t converted_ms = 0; // conversion time of the last fetched result, for the energy accounting
+};
+
+// Normal mode with IIR filter, forced mode if that fails
+class BaroBMP280 : public BaroDriver {
+  public:
+    BMP280 bmp;
+    bool background = false;
+    uint32_t ready_at = 0;
+    uint8_t conv_ms = 0;
+
+    bool begin(){
+      if(!bmp.begin()){ return false;} //0x76
+      bmp.setOversampling(4);
+      background = bmp.startNormalMode();
+      return true;
+    }
+    void start(){
+      if(background){ return;}
+      conv_ms = bmp.startMeasurment();
+      converted_ms = conv_ms;
+      ready_at = time() + conv_ms;
+    }
+    bool ready(){ return background || (int32_t)(time() - ready_at) > 0;}
+    bool fetch(float &P, float &T){
+      double p, t;
+      if(bmp.getTemperatureAndPressure(t, p) != 1){ return false;}
+      P = p;
+      T = t;
+      return true;
+    }
+    uint16_t conversion_ms(){ return background ? 0 : conv_ms;}
+    const char* name(){ return "BMP280";}
+};
+
+// Background mode into the FIFO, all results since the last wake are averaged. Triggered mode if that fails.
+class BaroSPL06 : public BaroDriver {
+  public:
+    SPL06 spl;
+    bool background = false;
+    uint32_t ready_at = 0;
+    int32_t praw = 0, traw = 0; // last FIFO averages
+
+    bool begin(){
+      if(!spl.begin(0x77)){ return false;}
+      background = (spl.start_background() == 0);
+      return true;
+    }
+    void start(){
+      if(background){ return;}
+      spl.start_measure();
+      converted_ms = 27;
+      ready_at = time() + 27;
+    }
+    bool ready(){ return background || (int32_t)(time() - ready_at) > 0;}
+    bool fetch(float &P, float &T){
+      if(background){
+        if(!spl.read_fifo(praw, traw) && !praw){ return false;} // first second after start, nothing measured yet
+      } else {
+        if(!spl.read_raw(praw, traw)){ return false;}
+        spl.sleep();
+      }
+      P = spl.get_pressure(praw, traw);
+      T = spl.get_temp_c(traw);
+      return P > 0;
+    }
+    uint16_t conversion_ms(){ return background ? 0 : 27;}
+    const char* name(){ return "SPL06";}
+};
+
+// Pipelined: fetch() reads the conversion started at the previous fetch() and starts the next one to finish during
+// sleep, with the best OSR that fits into the last read interval
+class BaroHP203B : public BaroDriver {
+  public:
+    HP203B hp; // 0x76 or 0x77
+    uint32_t last_read = 0;
+
+    bool begin(){
+      if(!hp.begin(0x76, OSR_4096)){ return false;}
+      hp.startMeasure();
+      return true;
+    }
+    void start(){
+      if(!hp.busy() && !hp.dataReady()){ hp.startMeasure();} // nothing converting, e.g. sensor brown out
+    }
+    bool ready(){ return hp.dataReady();}
+    bool fetch(float &P, float &T){
+      if(!hp.readMeasurement()){ return false;}
+      P = hp.hp_sensorData.P;
+      T = hp.hp_sensorData.T;
+      converted_ms = hp.conversionTime(hp.getOSR());
+      hp.setOSR(hp.osrForBudget(time() - last_read));
+      last_read = time();
+      hp.startMeasure();
+      return P > 0;
+    }
+    uint16_t conversion_ms(){ return 0;}
+    const char* name(){ return "HP203B";}
+};
+
+// Adafruit_BMP3XX only has the blocking performReading() (forced mode), so start() does the conversion. The output data
+// rate only applies to normal mode and is left alone, begin_I2C() sets oversampling and IIR.
+class BaroBMP3xx : public BaroDriver {
+  public:
+    Adafruit_BMP3XX bmp;
+    bool data_ok = false;
+
+    bool begin(){
+      return bmp.begin_I2C(0x76);
+    }
+    void start(){
+      data_ok = bmp.performReading();
+      converted_ms = 5;
+    }
+    bool ready(){ return true;}
+    bool fetch(float &P, float &T){
+      if(!data_ok){ return false;}
+      P = bmp.pressure/100;
+      T = bmp.temperature;
+      return P > 0;
+    }
+    uint16_t conversion_ms(){ return 0;}
+    const char* name(){ return "BMP3xx";}
+};
+
+// Reduction to sea level with the station temperature. The factor only changes with the altitude setting and the
+// temperature, so pow() runs again only when one of them moved (0.05 °C is ~0.03 hPa at 1500 m).
+float baro_factor_alt = NAN;
+float baro_factor_temp = NAN;
+float baro_factor = 1;
+
+float baro_sealevel_factor(float altitude, float T){
+  if(altitude != baro_factor_alt || !(fabsf(T - baro_factor_temp) < 0.05f)){
+    baro_factor_alt = altitude;
+    baro_factor_temp = T;
+    baro_factor = pow(1-(0.0065*altitude/(T + (0.0065*altitude) + 273.15)),-5.257);
+  }
+  return baro_factor;
+}
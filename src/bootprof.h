@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+#include "logging.h"
+
+// Boot profile: millis() per phase of setup(), to track the time from reset to the first transmission across firmware
+// versions. boot_phase() books the time since the previous mark to a phase, so a phase may be booked in several parts.
+// Printed at the end of setup() and with BOOT=1 over USB, sent once as the first info frame after boot.
+
+enum BootPhase {
+  BOOT_CORE,     // reset to setup(): core init, USB stack
+  BOOT_I2C_SCAN,
+  BOOT_DISPLAY,
+  BOOT_FLASH,    // USB MSC, mount (format)
+  BOOT_SETTINGS, // snapshot or parse_file()
+  BOOT_RADIO,    // radio_init() probe
+  BOOT_PM,       // setup_PM(), WDT
+  BOOT_BARO,
+  BOOT_OTHER,    // rest of setup()
+  BOOT_PHASES
+};
+
+const char* const boot_phase_names[BOOT_PHASES] = {"CORE", "I2C", "DISPLAY", "FLASH", "SETTINGS", "RADIO", "PM", "BARO", "OTHER"};
+const char boot_phase_tags[BOOT_PHASES + 1] = "CIDFSRPBO"; // info frame
+
+uint16_t boot_ms[BOOT_PHASES];
+uint32_t boot_mark = 0; // millis() of the last mark
+uint32_t boot_total = 0; // millis() at the end of setup()
+bool boot_report_pending = false; // info frame not sent yet
+
+void boot_phase(uint8_t phase){
+  uint32_t now = millis();
+  uint32_t ms = boot_ms[phase] + (now - boot_mark);
+  boot_ms[phase] = ms > 0xFFFF ? 0xFFFF : ms;
+  boot_mark = now;
+}
+
+void boot_begin(){
+  for(uint8_t i = 0; i < BOOT_PHASES; i++){ boot_ms[i] = 0;}
+  boot_mark = 0;
+  boot_total = 0;
+  boot_phase(BOOT_CORE);
+}
+
+void boot_end(){
+  boot_phase(BOOT_OTHER);
+  boot_total = millis();
+  boot_report_pending = true;
+}
+
+void boot_print(){
+  log_i("# Boot [phase: ms]\r\n");
+  for(uint8_t i = 0; i < BOOT_PHASES; i++){
+    log_i(boot_phase_names[i]);
+    log_i(": ", (uint32_t)boot_ms[i]);
+  }
+  log_i("Total [ms]: ", boot_total);
+}
+
+// "boot 1234ms C500 I12 ..." for the info frame, phases under 1 ms left out; returns the length like snprintf
+int boot_format(char *buf, int size){
+  int len = snprintf(buf, size, "boot %lums", (unsigned long)boot_total);
+  for(uint8_t i = 0; i < BOOT_PHASES; i++){
+    if(!boot_ms[i]){ continue;}
+    len += snprintf(buf + min(len, size), size - min(len, size), " %c%u", boot_phase_tags[i], boot_ms[i]);
+  }
+  return len;
+}
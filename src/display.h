@@ -1,8 +1,21 @@
  #pragma once
  #include <Arduino.h>
 
+ #ifndef NATIVE
  #define USE_DISPLAY // enable support for SSD1306 128x64 0.96" I2C display
+ #endif
  bool printdelay = false;
+ bool display_init_ok = false;
+
+bool display_present(){
+    return display_init_ok;
+}
+
+void display_delay(uint32_t t){
+    if(display_init_ok){
+        delay(t);  // wait some time to keep the message on the screen
+    }
+}
 
 // Display
 #ifdef USE_DISPLAY
@@ -40,13 +53,6 @@ Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 String line[NUM_LINES];
 int line_pos = NUM_LINES-1;
 int linecount =0;
-bool display_init_ok = false;
-
-void display_delay(uint32_t t){
-    if(display_init_ok){
-        delay(t);  // wait some time to keep the message on the screen
-    }
-}
 
 bool display_check_present(uint8_t address){
     Wire.beginTransmission(address);
@@ -56,10 +62,6 @@ bool display_check_present(uint8_t address){
     return false;
 }
 
-bool display_present(){
-    return display_init_ok;
-}
-
 void display_clear(){
     display.clearDisplay();
     display.display();
@@ -99,6 +101,8 @@ if(display_init_ok){
     if(linecount > NUM_LINES){ linecount = NUM_LINES;}
     display_print_linebuffer();
 }
+#else
+  (void)txt;
 #endif
 }
 
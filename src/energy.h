@@ -0,0 +1,81 @@
+#pragma once
+#include <Arduino.h>
+#include "logging.h"
+
+// Energy accounting: time spent per power phase times a current table gives the estimated average current (= µAh per hour),
+// to compare firmware builds on live stations without a shunt. The base phases ACTIVE, SLEEP and UART don't overlap and add
+// up to the accounted time, the others are loads on top of them. Currents are set with I_<phase> in the settings file.
+
+enum EnergyPhase {
+  ENERGY_ACTIVE,  // CPU running in loop()
+  ENERGY_SLEEP,   // standby
+  ENERGY_UART,    // idle sleep while a WSXX block arrives by DMA
+  ENERGY_BARO,    // baro conversion
+  ENERGY_TX,      // radio transmitting, send_active until transmittedFlag
+  ENERGY_HEATER,
+  ENERGY_USB,     // USB attached
+  ENERGY_PHASES
+};
+#define ENERGY_BASE_PHASES 3
+
+const char* const energy_phase_names[ENERGY_PHASES] = {"ACTIVE", "SLEEP", "UART", "BARO", "TX", "HEATER", "USB"};
+
+uint32_t energy_current[ENERGY_PHASES] = {6000, 180, 2500, 700, 45000, 800000, 10000}; // µA, rough defaults
+uint64_t energy_ms[ENERGY_PHASES];
+uint32_t energy_awake_since = 0; // millis()
+
+void energy_add(uint8_t phase, uint32_t ms){
+  energy_ms[phase] += ms;
+}
+
+// called at wakeup, millis() doesn't run in standby
+void energy_awake_begin(){
+  energy_awake_since = millis();
+}
+
+// called before sleep, books the time since energy_awake_begin()
+void energy_awake_end(){
+  uint32_t ms = millis() - energy_awake_since;
+  energy_add(ENERGY_ACTIVE, ms);
+  if(usb_connected){ energy_add(ENERGY_USB, ms);}
+  energy_awake_since = millis();
+}
+
+void energy_reset(){
+  for(uint8_t i = 0; i < ENERGY_PHASES; i++){ energy_ms[i] = 0;}
+  energy_awake_begin();
+}
+
+// setting I_<phase> = µA
+bool energy_set_current(const char* phase, uint32_t ua){
+  for(uint8_t i = 0; i < ENERGY_PHASES; i++){
+    if(strcmp(phase, energy_phase_names[i]) == 0){
+      energy_current[i] = ua;
+      return true;
+    }
+  }
+  return false;
+}
+
+// estimated average current over the accounted time in µA
+uint32_t energy_avg_ua(){
+  energy_awake_end(); // include the running awake phase
+  uint64_t total = 0;
+  uint64_t charge = 0; // µA*ms
+  for(uint8_t i = 0; i < ENERGY_PHASES; i++){
+    if(i < ENERGY_BASE_PHASES){ total += energy_ms[i];}
+    charge += energy_ms[i] * energy_current[i];
+  }
+  return total ? charge / total : 0;
+}
+
+void energy_print(){
+  uint32_t avg = energy_avg_ua();
+  log_i("# Energy [phase: s, uAh]\r\n");
+  for(uint8_t i = 0; i < ENERGY_PHASES; i++){
+    log_i(energy_phase_names[i]);
+    log_i(": ", (uint32_t)(energy_ms[i] / 1000));
+    log_i("  uAh: ", (uint32_t)(energy_ms[i] * energy_current[i] / 3600000));
+  }
+  log_i("Avg current [uA]: ", avg);
+}
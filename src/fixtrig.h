@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+
+// Fixed point trigonometry for wind direction averaging, the SAMD21 has no FPU
+// Angles in whole degrees, sin/cos in Q15 (32767 = 1.0), atan2 result in 1/1024 degree
+
+// sin(0..90 deg) in Q15, other quadrants by symmetry
+const int16_t sin_q15_table[91] = {
+  0, 572, 1144, 1715, 2286, 2856, 3425, 3993, 4560, 5126, 5690, 6252, 6813,
+  7371, 7927, 8481, 9032, 9580, 10126, 10668, 11207, 11743, 12275, 12803, 13328, 13848,
+  14364, 14876, 15383, 15886, 16383, 16876, 17364, 17846, 18323, 18794, 19260, 19720, 20173,
+  20621, 21062, 21497, 21925, 22347, 22762, 23170, 23571, 23964, 24351, 24730, 25101, 25465,
+  25821, 26169, 26509, 26841, 27165, 27481, 27788, 28087, 28377, 28659, 28932, 29196, 29451,
+  29697, 29934, 30162, 30381, 30591, 30791, 30982, 31163, 31335, 31498, 31650, 31794, 31927,
+  32051, 32165, 32269, 32364, 32448, 32523, 32587, 32642, 32687, 32722, 32747, 32762, 32767
+};
+
+// atan(i/64) for i = 0..64 in 1/1024 degree, linear interpolation in between
+const uint16_t atan_q10_table[65] = {
+  0, 917, 1833, 2748, 3662, 4574, 5484, 6392, 7296, 8197, 9094, 9986, 10875,
+  11758, 12635, 13507, 14373, 15233, 16086, 16932, 17771, 18602, 19426, 20242, 21049, 21849,
+  22640, 23423, 24196, 24962, 25718, 26465, 27203, 27931, 28651, 29361, 30062, 30754, 31437,
+  32110, 32774, 33428, 34073, 34710, 35337, 35955, 36564, 37164, 37755, 38337, 38911, 39476,
+  40032, 40580, 41120, 41651, 42174, 42690, 43197, 43696, 44188, 44672, 45149, 45618, 46080
+};
+
+int16_t sin_q15(int deg){
+  while(deg >= 360){ deg -= 360;}
+  while(deg < 0){ deg += 360;}
+  if(deg <= 90){ return sin_q15_table[deg];}
+  if(deg <= 180){ return sin_q15_table[180 - deg];}
+  if(deg <= 270){ return -sin_q15_table[deg - 180];}
+  return -sin_q15_table[360 - deg];
+}
+
+int16_t cos_q15(int deg){
+  return sin_q15(deg + 90);
+}
+
+// atan(num/den) for 0 <= num <= den, den > 0, in 1/1024 degree (0..45*1024)
+int32_t atan_q10_octant(uint32_t num, uint32_t den){
+  while(den >= 0x8000){ num >>= 1; den >>= 1;} // keep the Q15 ratio within 32 bit
+  uint32_t t = (num << 15) / den; // Q15, 0..32768
+  uint32_t i = t >> 9;
+  uint32_t frac = t & 0x1FF;
+  if(i >= 64){ return atan_q10_table[64];}
+  return atan_q10_table[i] + (((atan_q10_table[i+1] - atan_q10_table[i]) * frac + 0x100) >> 9);
+}
+
+// atan2(y, x) in 1/1024 degree, range -180*1024 .. 180*1024, 0 for (0,0) like atan2()
+int32_t atan2_q10(int32_t y, int32_t x){
+  uint32_t ax = x < 0 ? -(uint32_t)x : x;
+  uint32_t ay = y < 0 ? -(uint32_t)y : y;
+  int32_t a;
+  if(!ax && !ay){ return 0;}
+  if(ay <= ax){ a = atan_q10_octant(ay, ax);}
+  else { a = 90*1024 - atan_q10_octant(ax, ay);}
+  if(x < 0){ a = 180*1024 - a;}
+  if(y < 0){ a = -a;}
+  return a;
+}
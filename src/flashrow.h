@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#ifndef NATIVE
+#include <FlashStorage.h>
+#endif
+
+// Flash rows for FlashStorageClass, declared with a name of our own instead of the one the FlashStorage() macro makes up.
+// For the compiler a row is a const array of zeros, so plain loads from it are folded to 0: read it with flash_row_read().
+
+#ifdef NATIVE
+// bench: same const row in a writable section, flash_row_write() copies into it
+#define FLASH_ROW(name, T) \
+  static const uint8_t name[(sizeof(T) + 255)/256*256] __attribute__((aligned(256), section(".data." #name))) = {}
+
+void flash_row_write(const uint8_t *row, const void *data, uint16_t len){ memcpy((void*)row, data, len);}
+#else
+#define FLASH_ROW(name, T) \
+  __attribute__((__aligned__(256))) static const uint8_t name[(sizeof(T) + 255)/256*256] = {}
+#endif
+
+void flash_row_read(const uint8_t *row, void *data, uint16_t len){
+  const volatile uint8_t *p = row;
+  for(uint16_t i = 0; i < len; i++){ ((uint8_t*)data)[i] = p[i];}
+}
@@ -1,9 +1,17 @@
 #pragma once
 #include <Arduino.h>
 #include "logging.h"
+#include "fixtrig.h"
 
 extern uint32_t time();
 
+// Not cleared by the startup code, kept over a software or watchdog reset (see warm.h). The linker script has no .noinit,
+// the section is declared nobits ('@' comments out the flags gcc appends) so it lands after .bss and costs no flash.
+#ifdef NATIVE
+#define NOINIT
+#else
+#define NOINIT __attribute__((section(".noinit,\"aw\",%nobits@")))
+#endif
 
 // Gust History, for data transmission
 typedef struct g{
@@ -21,12 +29,13 @@ typedef struct g{
 #define GUST_AGE 1000*60*10 // 10 min history
 #define WIND_HIST_STEP 1000*4 //ms history slots, 22 sek
 #define WIND_HIST_LEN 150 // number so slots. should match GUST_AGE / GUST_HIST_STEP
-WindSample wind_history[WIND_HIST_LEN]; // gust ringbuffer
+#define GUST_RANK 5 // default: send the 5th highest gust to avoid a reading error or one time high value
+NOINIT WindSample wind_history[WIND_HIST_LEN]; // gust ringbuffer
 uint8_t wind_hist_pos = 0; // current position in ringbuffer
 
 // Data histroy, mainly for heater control
 typedef struct h{
-  bool set = false;
+  bool set; // no initializer: history[] is NOINIT and cleared in setup() on a cold start
   int8_t wind;
   int8_t temp;
   int8_t humd;
@@ -36,22 +45,332 @@ typedef struct h{
   bool pv_done;
 } History;
 
-History history[HISTORY_LEN];
+NOINIT History history[HISTORY_LEN] __attribute__((aligned(4))); // word aligned for the DSU CRC
 int hist_count =0;
 uint32_t last_history =0;
+bool hist_dirty = false; // wind_history[] or history[] changed since the last warm_seal()
 
 
+// Wind windows ----------------------------------------------------------------------------------------------------------------------
+// Running sums over the newest slots of wind_history that are younger than age. Slot times increase towards wind_hist_pos,
+// so a window is always the contiguous range tail .. tail+len-1 ending at the current slot. Slots enter when they get a time,
+// are updated in place while current, and leave at the tail on expiry (checked when queried) or when the ringbuffer wraps.
+#define WIND_WINDOWS 2 // wind_age and gust_age
+
+typedef struct {
+  uint32_t age;       // ms, 0 = unused
+  uint32_t last_used; // for replacement if more ages are queried than windows exist
+  uint8_t tail;       // oldest slot in window
+  uint8_t len;        // number of slots in window
+  uint32_t sum_wind;
+  uint32_t sum_gust;
+  int32_t sum_x;      // sum of cos(dir), Q15
+  int32_t sum_y;      // sum of sin(dir), Q15
+  uint16_t gusts[WIND_HIST_LEN]; // gust values of the window slots, sorted ascending
+} WindWindow;
+
+WindWindow wind_windows[WIND_WINDOWS];
+uint32_t wind_window_clock = 0;
+
+int32_t dir_x(int dir){ return cos_q15(dir);}
+int32_t dir_y(int dir){ return sin_q15(dir);}
+
+uint16_t gust_key(uint32_t gust){ return gust > 0xFFFF ? 0xFFFF : gust;}
+
+// first position in the n sorted gusts that is not below g
+int wind_window_gust_find(WindWindow *w, int n, uint16_t g){
+  int lo = 0, hi = n;
+  while(lo < hi){
+    int mid = (lo + hi) >> 1;
+    if(w->gusts[mid] < g){ lo = mid + 1;} else { hi = mid;}
+  }
+  return lo;
+}
+
+void wind_window_gust_insert(WindWindow *w, int n, uint32_t gust){
+  uint16_t g = gust_key(gust);
+  int i = wind_window_gust_find(w, n, g);
+  memmove(&w->gusts[i + 1], &w->gusts[i], (n - i) * sizeof(uint16_t));
+  w->gusts[i] = g;
+}
+
+void wind_window_gust_remove(WindWindow *w, int n, uint32_t gust){
+  int i = wind_window_gust_find(w, n, gust_key(gust));
+  if(i < n){
+    memmove(&w->gusts[i], &w->gusts[i + 1], (n - i - 1) * sizeof(uint16_t));
+  }
+}
+
+uint8_t wind_window_head(WindWindow *w){
+  int h = w->tail + w->len - 1;
+  if(h >= WIND_HIST_LEN){ h -= WIND_HIST_LEN;}
+  return h;
+}
+
+// remove oldest slot from window
+void wind_window_pop_tail(WindWindow *w){
+  WindSample *s = &wind_history[w->tail];
+  wind_window_gust_remove(w, w->len, s->gust);
+  w->sum_wind -= s->wind;
+  w->sum_gust -= s->gust;
+  w->sum_x -= dir_x(s->dir_raw);
+  w->sum_y -= dir_y(s->dir_raw);
+  w->tail++;
+  if(w->tail == WIND_HIST_LEN){ w->tail = 0;}
+  w->len--;
+}
+
+// drop slots older than the window age
+void wind_window_expire(WindWindow *w){
+  while(w->len && (!wind_history[w->tail].time || (time() - wind_history[w->tail].time) >= w->age)){
+    wind_window_pop_tail(w);
+  }
+}
+
+// recalculate window from ringbuffer, walking back from the current slot
+void wind_window_rebuild(WindWindow *w, uint32_t age){
+  w->age = age;
+  w->tail = wind_hist_pos;
+  w->len = 0;
+  w->sum_wind = 0;
+  w->sum_gust = 0;
+  w->sum_x = 0;
+  w->sum_y = 0;
+  int p = wind_hist_pos;
+  for( int i = 0; i < WIND_HIST_LEN; i++){
+    WindSample *s = &wind_history[p];
+    if(!s->time || (time() - s->time) >= age){ break;}
+    wind_window_gust_insert(w, w->len, s->gust);
+    w->sum_wind += s->wind;
+    w->sum_gust += s->gust;
+    w->sum_x += dir_x(s->dir_raw);
+    w->sum_y += dir_y(s->dir_raw);
+    w->tail = p;
+    w->len++;
+    p--;
+    if(p < 0){ p += WIND_HIST_LEN;}
+  }
+}
+
+// mark all windows unused, they are rebuilt on the next query
+void wind_windows_reset(){
+  for(int i = 0; i < WIND_WINDOWS; i++){
+    wind_windows[i].age = 0;
+    wind_windows[i].len = 0;
+    wind_windows[i].last_used = 0;
+  }
+}
+
+// get window for age, replaces the least recently used one if no window matches
+WindWindow* wind_window_get(uint32_t age){
+  WindWindow *w = &wind_windows[0];
+  for(int i = 0; i < WIND_WINDOWS; i++){
+    if(wind_windows[i].age == age){ w = &wind_windows[i]; break;}
+    if(wind_windows[i].last_used < w->last_used){ w = &wind_windows[i];}
+  }
+  if(w->age != age){
+    wind_window_rebuild(w, age);
+  } else {
+    wind_window_expire(w);
+  }
+  w->last_used = ++wind_window_clock;
+  return w;
+}
+
+// slot p is going to be overwritten by the ringbuffer, remove it from windows still holding it
+void wind_windows_drop(uint8_t p){
+  for(int i = 0; i < WIND_WINDOWS; i++){
+    WindWindow *w = &wind_windows[i];
+    if(w->age && w->len && w->tail == p){ wind_window_pop_tail(w);}
+  }
+}
+
+// slot p changed from old to its current content, update sums of all windows
+void wind_windows_update(uint8_t p, const WindSample &old){
+  WindSample *s = &wind_history[p];
+  bool dir_changed = old.dir_raw != s->dir_raw;
+  int32_t x = 0, y = 0, old_x = 0, old_y = 0;
+  bool trig_done = false, old_trig_done = false;
+
+  for(int i = 0; i < WIND_WINDOWS; i++){
+    WindWindow *w = &wind_windows[i];
+    if(!w->age){ continue;}
+    if(w->len && wind_window_head(w) == p){ // slot already in window, replace contribution
+      w->sum_wind += s->wind - old.wind;
+      if(s->gust != old.gust){
+        wind_window_gust_remove(w, w->len, old.gust);
+        wind_window_gust_insert(w, w->len - 1, s->gust);
+        w->sum_gust += s->gust - old.gust;
+      }
+      if(dir_changed){
+        if(!trig_done){ x = dir_x(s->dir_raw); y = dir_y(s->dir_raw); trig_done = true;}
+        if(!old_trig_done){ old_x = dir_x(old.dir_raw); old_y = dir_y(old.dir_raw); old_trig_done = true;}
+        w->sum_x += x - old_x;
+        w->sum_y += y - old_y;
+      }
+    } else { // slot just got its time, append to window
+      if(!trig_done){ x = dir_x(s->dir_raw); y = dir_y(s->dir_raw); trig_done = true;}
+      if(!w->len){ w->tail = p;}
+      wind_window_gust_insert(w, w->len, s->gust);
+      w->len++;
+      w->sum_wind += s->wind;
+      w->sum_gust += s->gust;
+      w->sum_x += x;
+      w->sum_y += y;
+    }
+  }
+}
+
+// WMO wind ----------------------------------------------------------------------------------------------------------------------
+// Standard definitions next to the windows above: mean wind over 10 or 2 min, gust = highest 3 s gust within 10 min and the
+// direction variability (Yamartino sigma theta). Every closed wind_history slot is booked into the current 15 s bucket of a
+// 10 min ring and into running sums for both means, O(1) per slot; the gust maximum is taken over the 40 buckets on query.
+// The 3 s gust of a slot comes from the sensor (WSxx gust field, Davis pulse intervals), slots are 4 s or longer.
+#define WMO_BUCKET_MS 15000
+#define WMO_BUCKETS 40 // 10 min
+#define WMO_SHORT_BUCKETS 8 // 2 min
+
+#define WIND_MODE_RANK 0 // mean over wind_age, gust_rank / gust_percentile within gust_age
+#define WIND_MODE_WMO 1 // 10 min mean, max 3 s gust in 10 min
+#define WIND_MODE_2MIN 2 // 2 min mean, max 3 s gust in 10 min
+
+typedef struct {
+  uint32_t sum_wind; // 0.1 km/h
+  int32_t sum_x;     // sum of cos(dir), Q15
+  int32_t sum_y;     // sum of sin(dir), Q15
+  uint16_t count;
+} WmoSum;
+
+typedef struct {
+  WmoSum sum;
+  uint16_t gust; // highest, 0.1 km/h
+} WmoBucket;
+
+typedef struct {
+  uint16_t wind10;
+  uint16_t gust10;
+  int dir_raw;
+  float sigma; // deg
+  uint16_t count; // slots in the mean
+} WmoWind;
+
+WmoBucket wmo_buckets[WMO_BUCKETS];
+WmoSum wmo_long, wmo_short; // running sums of the newest WMO_BUCKETS / WMO_SHORT_BUCKETS buckets
+uint32_t wmo_epoch = 0; // bucket number (time / WMO_BUCKET_MS) of the newest bucket
+bool wmo_started = false;
+
+void wmo_sum_add(WmoSum &s, const WmoSum &a){
+  s.sum_wind += a.sum_wind;
+  s.sum_x += a.sum_x;
+  s.sum_y += a.sum_y;
+  s.count += a.count;
+}
+
+void wmo_sum_sub(WmoSum &s, const WmoSum &a){
+  s.sum_wind -= a.sum_wind;
+  s.sum_x -= a.sum_x;
+  s.sum_y -= a.sum_y;
+  s.count -= a.count;
+}
+
+void wmo_reset(){
+  memset(wmo_buckets, 0, sizeof(wmo_buckets));
+  memset(&wmo_long, 0, sizeof(wmo_long));
+  memset(&wmo_short, 0, sizeof(wmo_short));
+  wmo_started = false;
+}
+
+// move the newest bucket to time t, buckets leaving a window are taken out of its sums
+void wmo_advance(uint32_t t){
+  uint32_t b = t / WMO_BUCKET_MS;
+  if(wmo_started && wmo_epoch - b < WMO_BUCKETS){ return;} // same bucket (or slightly back)
+  if(!wmo_started || b - wmo_epoch >= WMO_BUCKETS){ // first slot, 10 min gap or time() wrapped
+    wmo_reset();
+    wmo_epoch = b;
+    wmo_started = true;
+    return;
+  }
+  while(wmo_epoch < b){
+    wmo_epoch++;
+    WmoBucket *old = &wmo_buckets[wmo_epoch % WMO_BUCKETS];
+    wmo_sum_sub(wmo_long, old->sum);
+    wmo_sum_sub(wmo_short, wmo_buckets[(wmo_epoch + WMO_BUCKETS - WMO_SHORT_BUCKETS) % WMO_BUCKETS].sum);
+    memset(old, 0, sizeof(*old));
+  }
+}
+
+// books a slot into the bucket of its time, slots older than 10 min are dropped
+void wmo_add(const WindSample &s){
+  wmo_advance(time());
+  uint32_t age = wmo_epoch - s.time / WMO_BUCKET_MS;
+  if(age >= WMO_BUCKETS){ return;}
+  WmoBucket *b = &wmo_buckets[(wmo_epoch - age) % WMO_BUCKETS];
+  WmoSum a = {s.wind, dir_x(s.dir_raw), dir_y(s.dir_raw), 1};
+  wmo_sum_add(b->sum, a);
+  wmo_sum_add(wmo_long, a);
+  if(age < WMO_SHORT_BUCKETS){ wmo_sum_add(wmo_short, a);}
+  if(gust_key(s.gust) > b->gust){ b->gust = gust_key(s.gust);}
+}
+
+// rebook the closed slots of wind_history, after a warm restart
+void wmo_rebuild(){
+  wmo_reset();
+  int p = wind_hist_pos;
+  for(int i = 1; i < WIND_HIST_LEN; i++){ // oldest first, the current slot is booked when it closes
+    if(++p == WIND_HIST_LEN){ p = 0;}
+    if(wind_history[p].time){ wmo_add(wind_history[p]);}
+  }
+}
+
+// Yamartino estimator of the standard deviation of the direction, deg
+float wmo_sigma(const WmoSum &s){
+  if(!s.count){ return 0;}
+  float sa = s.sum_y / (32767.0f * s.count);
+  float ca = s.sum_x / (32767.0f * s.count);
+  float e2 = 1 - (sa*sa + ca*ca);
+  if(e2 <= 0){ return 0;}
+  float e = sqrtf(e2);
+  return asinf(e) * (1 + 0.1547f*e*e*e) * 180 / M_PI;
+}
+
+// mean over 2 min (short) or 10 min, gust over 10 min, including the current slot
+WmoWind wmo_get(bool short_mean){
+  WmoWind ret = {0,0,0,0,0};
+  wmo_advance(time());
+  WmoSum s = short_mean ? wmo_short : wmo_long;
+  uint16_t gust = 0;
+  for(int i = 0; i < WMO_BUCKETS; i++){
+    if(wmo_buckets[i].gust > gust){ gust = wmo_buckets[i].gust;}
+  }
+  const WindSample &c = wind_history[wind_hist_pos];
+  if(c.time && time() - c.time < (short_mean ? WMO_SHORT_BUCKETS : WMO_BUCKETS) * WMO_BUCKET_MS){ // not booked yet
+    WmoSum a = {c.wind, dir_x(c.dir_raw), dir_y(c.dir_raw), 1};
+    wmo_sum_add(s, a);
+    if(gust_key(c.gust) > gust){ gust = gust_key(c.gust);}
+  }
+  if(!s.count){ return ret;}
+  ret.wind10 = s.sum_wind / s.count;
+  ret.gust10 = gust;
+  ret.dir_raw = atan2_q10(s.sum_y, s.sum_x) / 1024;
+  if(ret.dir_raw < 0){ ret.dir_raw += 360;}
+  ret.sigma = wmo_sigma(s);
+  ret.count = s.count;
+  return ret;
+}
+
 void check_wind_hist_bin(){
   if( wind_history[wind_hist_pos].time && (time() - wind_history[wind_hist_pos].time) > WIND_HIST_STEP){
     // copy old values if there is an read error from serial to avoid 0 to be included in average
     uint32_t g = wind_history[wind_hist_pos].gust;
     uint32_t w = wind_history[wind_hist_pos].wind;
     int d = wind_history[wind_hist_pos].dir_raw;
+    wmo_add(wind_history[wind_hist_pos]); // slot closed
 
     wind_hist_pos++;
     if(wind_hist_pos == WIND_HIST_LEN){
       wind_hist_pos = 0;
     }
+    wind_windows_drop(wind_hist_pos); // slot is about to be overwritten
     // reset values if already set (overwrite ringbuffer)
     wind_history[wind_hist_pos].gust = g;
     wind_history[wind_hist_pos].wind = w;
@@ -60,107 +379,90 @@ void check_wind_hist_bin(){
   }
 }
 
-// Adds/updates wind value in ringbuffer
-void add_wind_history_wind(float val_wind){
+// Adds/updates wind value in 0.1 km/h in ringbuffer
+void add_wind_history_wind10(uint32_t wind10){
   check_wind_hist_bin(); // Agg slot time is over, switch to next
-  wind_history[wind_hist_pos].wind = val_wind*10;
+  WindSample old = wind_history[wind_hist_pos];
+  wind_history[wind_hist_pos].wind = wind10;
   wind_history[wind_hist_pos].time = time();
+  wind_windows_update(wind_hist_pos, old);
+  hist_dirty = true;
 }
 
-// Adds/updates gust value in ringbuffer
-void add_wind_history_gust(float val_gust){
+// Adds/updates gust value in 0.1 km/h in ringbuffer
+void add_wind_history_gust10(uint32_t gust10){
   check_wind_hist_bin(); // Agg slot time is over, switch to next
-  wind_history[wind_hist_pos].gust = abs(val_gust)*10;
+  WindSample old = wind_history[wind_hist_pos];
+  wind_history[wind_hist_pos].gust = gust10;
   wind_history[wind_hist_pos].time = time();
+  wind_windows_update(wind_hist_pos, old);
+  hist_dirty = true;
+}
+
+// Adds/updates wind value in ringbuffer
+void add_wind_history_wind(float val_wind){
+  add_wind_history_wind10(val_wind*10);
+}
+
+// Adds/updates gust value in ringbuffer
+void add_wind_history_gust(float val_gust){
+  add_wind_history_gust10(abs(val_gust)*10);
 }
 
 // Adds/updates dir value in ringbuffer
 void add_wind_history_dir(int val_dir){
   check_wind_hist_bin(); // Agg slot time is over, switch to next
+  WindSample old = wind_history[wind_hist_pos];
   wind_history[wind_hist_pos].dir_raw = val_dir;
   wind_history[wind_hist_pos].time = time();
+  wind_windows_update(wind_hist_pos, old);
+  hist_dirty = true;
 }
 
-// gets the highest wind value in ringbuffer, not older than age
+// gets the average wind, gust and direction of the slots not older than age
 WindSample get_wind_from_hist(uint32_t age){
   WindSample ret = {0,0,0,0};
+  WindWindow *w = wind_window_get(age);
 
-  float y_part = 0;
-  float x_part = 0;
-  int samplecount =0;
-
-  uint8_t p = wind_hist_pos;
-  for( int i = 0; i < WIND_HIST_LEN; i++){
-    if(p == WIND_HIST_LEN){
-      p -= WIND_HIST_LEN;
-    }
-    if( ( wind_history[p].time && (time()- wind_history[p].time) < age)){
-      ret.wind += wind_history[p].wind;
-      ret.gust += wind_history[p].gust;
-      x_part += cos (wind_history[p].dir_raw * M_PI / 180);
-      y_part += sin (wind_history[p].dir_raw * M_PI / 180);
-      samplecount++;
-    }
-    p++;
-  }
-  if(samplecount > 0){
-    ret.dir_raw = atan2 (y_part / samplecount, x_part / samplecount) * 180 / M_PI;
+  if(w->len > 0){
+    ret.dir_raw = atan2_q10(w->sum_y, w->sum_x) / 1024; // truncated like the former float version
     if(ret.dir_raw <0){ ret.dir_raw +=360;}
-
-   // log_i("Sum Wind: ", ret.wind);
-   // log_i("Sum Gust: ", ret.gust);
-   // log_i("Samples: ", samplecount);
-    ret.wind /= samplecount;
-    ret.gust /= samplecount;
-  } else {
-    //log_e("Samplecount is 0\r\n");
+    ret.wind = w->sum_wind / w->len;
+    ret.gust = w->sum_gust / w->len;
   }
   return ret;
 }
 
-void insert_sorted(uint32_t* arr, int arrlen, uint32_t value){
-    if (value <= arr[arrlen - 1]) {
-        return; // value too small, skip
-    }
-    int i = 0;
-   // while (pos < arrlen && value < arr[pos]) {
-   //     pos++; // Find position to insert the value.
-   // }
-    // Shift elements down to make room for the new value.
-    for (i = arrlen - 1; (i >= 0 && arr[i] < value); i--) {
-        arr[i + 1] = arr[i]; // Verschiebe Elemente nach rechts
-    }
-   // if (pos < arrlen) {
-   //     memmove(&arr[pos + 1], &arr[pos], (arrlen - 1 - pos) * sizeof(uint32_t));
-   // }
-    arr[i+1] = value;
+// gets the rank-th highest gust value (1 = max) of the slots not older than age in 0.1 km/h, 0 if there are less samples
+uint16_t get_gust10_from_hist(uint32_t age, uint8_t rank = GUST_RANK){
+  WindWindow *w = wind_window_get(age);
+  if(!rank || rank > w->len){ return 0;}
+  return w->gusts[w->len - rank];
 }
 
-float get_gust_from_hist(uint32_t age){
-  #define GUSTBUFFERLEN 7
-  uint32_t ret[GUSTBUFFERLEN] = {0,0,0,0,0,0,0};
-  uint8_t p = wind_hist_pos;
-  for( int i = 0; i < WIND_HIST_LEN; i++){
-    if(p == WIND_HIST_LEN){
-      p -= WIND_HIST_LEN;
-    }
-    // check the hisftory for gust values within the set gust age.
-    if(( wind_history[p].time && (time()- wind_history[p].time) < age)){
-      //printf("age: %lu, value: %0.2f\n", (time()- wind_history[p].time), (float)(wind_history[p].gust)/10.0 );
-      insert_sorted(ret, GUSTBUFFERLEN, wind_history[p].gust);
-    }
-    p++;
-  }
-  //printf("0: %lu 1: %lu 2: %lu 3: %lu 4: %lu \n", ret[0], ret[1], ret[2], ret[3], ret[4] );
-  return ret[4]/10.0; // return 5th highest value to avoid sending a reading error or one time high value
+// gets the gust value at percentile (1..100, nearest rank) of the slots not older than age in 0.1 km/h
+uint16_t get_gust10_percentile_from_hist(uint32_t age, uint8_t percentile){
+  WindWindow *w = wind_window_get(age);
+  if(!w->len){ return 0;}
+  int r = (percentile * w->len + 99) / 100; // ascending rank, rounded up
+  if(r < 1){ r = 1;}
+  if(r > w->len){ r = w->len;}
+  return w->gusts[r - 1];
+}
+
+float get_gust_from_hist(uint32_t age, uint8_t rank = GUST_RANK){
+  return get_gust10_from_hist(age, rank)/10.0;
+}
+
+float get_gust_percentile_from_hist(uint32_t age, uint8_t percentile){
+  return get_gust10_percentile_from_hist(age, percentile)/10.0;
 }
 
 
 
 // History ----------------------------------------------------------------------------------------------------------------------
-// save history value if time is ready  for a new one
-void save_history(float wind_speed, float temperature, int humidity, int light_lux, float batt_volt, bool pv_charging, bool pv_done){
-  static uint32_t last_history = 0;
+// save history value if time is ready  for a new one, true if saved
+bool save_history(float wind_speed, float temperature, int humidity, int light_lux, float batt_volt, bool pv_charging, bool pv_done){
   if(time() - last_history > HISTORY_INTERVAL){
     last_history = time();
     hist_count++;
@@ -174,7 +476,10 @@ void save_history(float wind_speed, float temperature, int humidity, int light_l
     history[hist_count].batt = (batt_volt-2)*100;
     history[hist_count].pv_charging = pv_charging;
     history[hist_count].pv_done = pv_done;
+    hist_dirty = true;
+    return true;
   }
+  return false;
 }
 
 // calc sum of light sensor reading in n last ringbuffer entries
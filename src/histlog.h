@@ -0,0 +1,183 @@
+#pragma once
+#include <Arduino.h>
+#include "hist.h"
+#include "logging.h"
+#ifndef NATIVE
+#include <FlashStorage.h>
+#endif
+
+// History log: history[] survives resets in a ring of internal flash rows right below the FAT (see SAMD_InternalFlash.cpp).
+// The records since the last row write are still in history[], so no staging buffer: every HISTLOG_ROW_RECORDS records
+// one full row is packed from there and written to the next row of the ring. Each row carries a sequence number and a
+// CRC, at boot one scan over the row headers finds the newest and history[] is rebuilt from it backwards.
+// Wear: 41 records per row at HISTORY_INTERVAL 30 s are ~70 row writes a day spread over 80 rows, < 1 erase per row and
+// day (100k cycles endurance). The records not yet in a full row (up to ~20 min) are lost on reset.
+
+#define HISTLOG_ROW_SIZE 256 // SAMD21 NVM row, the erase unit
+#define HISTLOG_ROWS 80 // 20 KB
+#define HISTLOG_END (0x00040000 - 256 - 40*1024) // FAT start, INTERNAL_FLASH_FILESYSTEM_START_ADDR
+#define HISTLOG_START (HISTLOG_END - HISTLOG_ROWS*HISTLOG_ROW_SIZE)
+#define HISTLOG_MAGIC 0x4C48 // "HL"
+
+#define HISTLOG_SET 0x01
+#define HISTLOG_PV_CHARGING 0x02
+#define HISTLOG_PV_DONE 0x04
+
+typedef struct __attribute__((packed)) {
+  int8_t wind;
+  int8_t temp;
+  int8_t humd;
+  int8_t light;
+  int8_t batt;
+  uint8_t flags; // HISTLOG_SET, HISTLOG_PV_*
+} HistRecord;
+
+#define HISTLOG_ROW_RECORDS ((HISTLOG_ROW_SIZE - 8) / sizeof(HistRecord)) // 41
+
+typedef struct {
+  uint16_t magic;
+  uint16_t crc; // over seq and rec
+  uint32_t seq; // row write counter, the highest valid one is the newest row
+  HistRecord rec[HISTLOG_ROW_RECORDS];
+  uint8_t pad[HISTLOG_ROW_SIZE - 8 - HISTLOG_ROW_RECORDS*sizeof(HistRecord)];
+} HistLogRow;
+
+static_assert(sizeof(HistLogRow) == HISTLOG_ROW_SIZE, "history log row must fill one flash row");
+
+bool histlog_ok = false;
+uint16_t histlog_next = 0; // row to write next
+uint32_t histlog_seq = 1; // sequence number of the next row
+uint8_t histlog_pending = 0; // records in history[] not written yet
+
+// CRC-16/CCITT-FALSE
+uint16_t crc16(const uint8_t *data, uint32_t len, uint16_t crc = 0xFFFF){
+  while(len--){
+    crc ^= (uint16_t)(*data++) << 8;
+    for(uint8_t i = 0; i < 8; i++){ crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;}
+  }
+  return crc;
+}
+
+#ifdef NATIVE
+// bench: RAM instead of flash, erase counter per row
+uint8_t histlog_sim[HISTLOG_ROWS*HISTLOG_ROW_SIZE];
+uint32_t histlog_erases[HISTLOG_ROWS];
+
+const HistLogRow* histlog_row(uint16_t i){ return (const HistLogRow*)&histlog_sim[i*HISTLOG_ROW_SIZE];}
+
+void histlog_program(uint16_t i, const HistLogRow *row){
+  histlog_erases[i]++;
+  memcpy(&histlog_sim[i*HISTLOG_ROW_SIZE], row, HISTLOG_ROW_SIZE);
+}
+
+bool histlog_region_free(){ return true;}
+#else
+extern uint32_t __etext, __data_start__, __data_end__; // linker script
+FlashClass histlog_flash((const void*)HISTLOG_START, HISTLOG_ROWS*HISTLOG_ROW_SIZE);
+
+const HistLogRow* histlog_row(uint16_t i){ return (const HistLogRow*)(HISTLOG_START + i*HISTLOG_ROW_SIZE);}
+
+void histlog_program(uint16_t i, const HistLogRow *row){
+  histlog_flash.erase(histlog_row(i), HISTLOG_ROW_SIZE);
+  histlog_flash.write(histlog_row(i), row, HISTLOG_ROW_SIZE);
+}
+
+// firmware image (code + .data initializers) must end below the log
+bool histlog_region_free(){
+  return (uint32_t)&__etext + ((uint32_t)&__data_end__ - (uint32_t)&__data_start__) <= HISTLOG_START;
+}
+#endif
+
+bool histlog_row_valid(const HistLogRow *row){
+  return row->magic == HISTLOG_MAGIC && row->crc == crc16((const uint8_t*)&row->seq, sizeof(row->seq) + sizeof(row->rec));
+}
+
+// history[] slot, i records back from the newest
+int histlog_pos(int i){
+  int p = hist_count - i;
+  while(p < 0){ p += HISTORY_LEN;}
+  return p;
+}
+
+void histlog_write_row(){
+  HistLogRow row;
+  memset(&row, 0xFF, sizeof(row));
+  row.magic = HISTLOG_MAGIC;
+  row.seq = histlog_seq;
+  for(uint8_t r = 0; r < HISTLOG_ROW_RECORDS; r++){
+    History &h = history[histlog_pos(HISTLOG_ROW_RECORDS - 1 - r)]; // oldest first
+    row.rec[r].wind = h.wind;
+    row.rec[r].temp = h.temp;
+    row.rec[r].humd = h.humd;
+    row.rec[r].light = h.light;
+    row.rec[r].batt = h.batt;
+    row.rec[r].flags = (h.set ? HISTLOG_SET : 0) | (h.pv_charging ? HISTLOG_PV_CHARGING : 0) | (h.pv_done ? HISTLOG_PV_DONE : 0);
+  }
+  row.crc = crc16((const uint8_t*)&row.seq, sizeof(row.seq) + sizeof(row.rec));
+  histlog_program(histlog_next, &row);
+  histlog_next = (histlog_next + 1) % HISTLOG_ROWS;
+  histlog_seq++;
+}
+
+// after save_history() stored a record
+void histlog_append(){
+  if(!histlog_ok){ return;}
+  if(++histlog_pending == HISTLOG_ROW_RECORDS){
+    histlog_write_row();
+    histlog_pending = 0;
+  }
+}
+
+// boot: find the newest row, then fill history[] from the rows before it (consecutive sequence numbers only).
+// After a warm restart history[] and histlog_pending are still valid (warm.h), rebuild false only finds the next row.
+void histlog_restore(bool rebuild = true){
+  histlog_ok = histlog_region_free();
+  if(rebuild){ histlog_pending = 0;}
+  if(!histlog_ok){
+    log_e("History log: flash region used by firmware\r\n");
+    return;
+  }
+
+  int newest = -1;
+  for(uint16_t i = 0; i < HISTLOG_ROWS; i++){
+    const HistLogRow *row = histlog_row(i);
+    if(histlog_row_valid(row) && (newest < 0 || (int32_t)(row->seq - histlog_row(newest)->seq) > 0)){ newest = i;}
+  }
+  if(newest < 0){ // empty or erased region
+    histlog_next = 0;
+    histlog_seq = 1;
+    return;
+  }
+  uint32_t seq = histlog_row(newest)->seq;
+  histlog_next = (newest + 1) % HISTLOG_ROWS;
+  histlog_seq = seq + 1;
+  if(!rebuild){ return;}
+
+  uint16_t rows = 1; // rows to restore, oldest is newest - rows + 1
+  while(rows < HISTLOG_ROWS && rows*HISTLOG_ROW_RECORDS < HISTORY_LEN){
+    const HistLogRow *row = histlog_row((newest + HISTLOG_ROWS - rows) % HISTLOG_ROWS);
+    if(!histlog_row_valid(row) || row->seq != seq - rows){ break;}
+    rows++;
+  }
+
+  int n = rows*HISTLOG_ROW_RECORDS;
+  int skip = n > HISTORY_LEN ? n - HISTORY_LEN : 0; // oldest records that don't fit
+  int count = 0;
+  for(uint16_t r = rows; r > 0; r--){
+    const HistLogRow *row = histlog_row((newest + HISTLOG_ROWS - r + 1) % HISTLOG_ROWS);
+    for(uint8_t k = 0; k < HISTLOG_ROW_RECORDS; k++){
+      if(skip){ skip--; continue;}
+      History &h = history[count++];
+      h.set = row->rec[k].flags & HISTLOG_SET;
+      h.wind = row->rec[k].wind;
+      h.temp = row->rec[k].temp;
+      h.humd = row->rec[k].humd;
+      h.light = row->rec[k].light;
+      h.batt = row->rec[k].batt;
+      h.pv_charging = row->rec[k].flags & HISTLOG_PV_CHARGING;
+      h.pv_done = row->rec[k].flags & HISTLOG_PV_DONE;
+    }
+  }
+  hist_count = count - 1;
+  log_i("History restored: ", (uint32_t)count);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+#include "flashrow.h"
+
+// Hardware inventory: what setup() found on the last boot, in a flash row. With it setup() skips the I2C sweep (one probe
+// of the HW1.3 digipot confirms the hardware version), starts the known LoRa module and baro chip directly and only falls
+// back to probing all of them if that init fails. Rewritten only when something changed, a new firmware erases it.
+
+#define HWINV_MAGIC 0x56494857 // "WHIV"
+
+typedef struct {
+  uint32_t magic;
+  uint8_t hw_version;  // HW_Version
+  uint8_t lora_module; // LORA_MODULE
+  uint8_t baro_chip;   // BARO_CHIP, BARO_NONE if not probed yet
+  uint8_t display;     // SSD1306 present
+} HwInventory;
+
+HwInventory hwinv; // valid if hwinv.magic == HWINV_MAGIC
+
+FLASH_ROW(hwinv_row, HwInventory);
+#ifdef NATIVE
+void hwinv_write(const HwInventory &inv){ flash_row_write(hwinv_row, &inv, sizeof(inv));}
+#else
+FlashStorageClass<HwInventory> hwinv_flash(hwinv_row);
+void hwinv_write(const HwInventory &inv){ hwinv_flash.write(inv);}
+#endif
+
+void hwinv_read(HwInventory &inv){ flash_row_read(hwinv_row, &inv, sizeof(inv));}
+
+bool hwinv_load(){
+  hwinv_read(hwinv);
+  return hwinv.magic == HWINV_MAGIC;
+}
+
+bool hwinv_valid(){ return hwinv.magic == HWINV_MAGIC;}
+
+void hwinv_save(uint8_t hw_version, uint8_t lora_module, uint8_t baro_chip, bool display){
+  HwInventory inv;
+  inv.magic = HWINV_MAGIC;
+  inv.hw_version = hw_version;
+  inv.lora_module = lora_module;
+  inv.baro_chip = baro_chip;
+  inv.display = display;
+  HwInventory stored;
+  hwinv_read(stored);
+  if(!memcmp(&inv, &stored, sizeof(inv))){ return;}
+  hwinv_write(inv);
+  hwinv = inv;
+}
@@ -42,6 +42,7 @@ void log_i(const char * msg, int32_t num){
     Serial.println(num);
   }
 }
+#ifndef NATIVE // int32_t is long on arm-none-eabi but int on the host
 void log_i(const char * msg, int num){
   if(debug_enabled){
     DEBUGSER.print(msg);
@@ -53,6 +54,7 @@ void log_i(const char * msg, int num){
     Serial.println(num);
   }
 }
+#endif
 void log_i(const char * msg, float num){
   if(debug_enabled){
     DEBUGSER.print(msg);
@@ -1,10 +1,6 @@
 #include <Arduino.h>
 #include <Adafruit_TinyUSB.h>
 #include <Wire.h>
-#include <BMP280.h>
-#include <HP203B.h> // https://github.com/ncdcommunity/Arduino_Library_HP203B_Barometer_Altimeter_Sensor/tree/master
-#include <SPL06.h>
-#include <Adafruit_BMP3XX.h>
 #include <LibPrintf.h>
 #include <RadioLib.h>
 #include <SdFat.h>
@@ -19,6 +15,17 @@
 #include "types.h"
 #include "display.h"
 #include "hist.h"
+#include "wsxx.h"
+#include "schedule.h"
+#include "energy.h"
+#include "trace.h"
+#include "baro.h"
+#include "histlog.h"
+#include "warm.h"
+#include "settings.h"
+#include "bootprof.h"
+#include "hwinv.h"
+#include "pulse.h"
 
  #define HAS_HEATER // support for Heater (HW V1.x)
 
@@ -36,6 +43,7 @@
 // SAMD_InternalFlash.cpp:  
 // use last 40kb of flash as FAT12 disk for settings file
 //    _flash_address = (0x00040000 - 256 - 0 - INTERNAL_FLASH_FILESYSTEM_SIZE)
+// Adafruit_InternalFlash_Wrapper: no Adafruit_FlashCache, blocks go to the row granular InternalFlash::program()
 
 // Improvements
 // LDO: 
@@ -47,7 +55,6 @@
 // avg @40s send interval: 2.25mA (with WS80 1.2.8)
 
 #define FANET_VENDOR_ID 0xBD
-#define VBATT_LOW 3.35 // Volt
 
 Adafruit_USBD_MSC usb_msc;
 #define DISK_BLOCK_SIZE 512 // Block size in bytes for tinyUSB flash drive. Should be always 512
@@ -61,7 +68,6 @@ TinyGPSPlus tinyGps;
 #define BROADCAST_INTERVAL 40*1000UL // dafault value,  overwritten by settingfile
 
 #define DEBUGSER Serial1
-#define WSXX_UART Serial1
 #define GPS_SERIAL Serial1 // if no WS80 is connected a GPS receiver can be used. Mainly for OGN range/coverage check
 
 // https://github.com/adafruit/ArduinoCore-samd/blob/master/variants/itsybitsy_m0/variant.cpp
@@ -110,10 +116,11 @@ Uart Serial2(&sercom1, PIN_SERCOM1_RX, PIN_SERCOM1_TX, SERCOM_RX_PAD_1, UART_TX_
 #define PIN_SCL 27 // PA23
 
 // I2C Barometer
-BMP280 bmp280; // Bosch BMP280
-SPL06 spl; // Goertek SPL06-001
-HP203B hp; // HP203B 0x76 or 0x77
-Adafruit_BMP3XX bmp3xx;
+BaroBMP280 baro_bmp280; // Bosch BMP280
+BaroSPL06 baro_spl06; // Goertek SPL06-001
+BaroHP203B baro_hp203b; // HP203B 0x76 or 0x77
+BaroBMP3xx baro_bmp3xx;
+BaroDriver* baro = NULL;
 // DPS310 as alternative?
 
 // DAVIS6410 Pinout
@@ -133,6 +140,7 @@ Adafruit_BMP3XX bmp3xx;
 
 #define VERSIONFILE (char*) "version.txt"
 #define SETTINGSFILE (char*) "settings.txt"
+#define SETTINGSFILE_83 "SETTINGSTXT" // directory entry name of SETTINGSFILE
 
 
 #define MCP4652_I2C_ADDR	0x2F
@@ -164,7 +172,9 @@ bool first_sleep = true; // first sleep after reset, USB perephial could still b
 bool usb_connected = false;
 
 uint32_t sleep_allowed = 0; // time() when is is ok so eenter deepsleep
+uint32_t send_active = 0; // if > 0, time() last message was send to tx queue, reset to 0 if send is complete
 uint32_t sleeptime_cum = 0; // cumulative time spend in sleepmode, used for time() calculation
+uint32_t boot_time = 0; // time() at reset, not 0 after a warm restart
 int heading_offset = 0;
 
 // ### Variables for storing settings from file, may be overewritten #####
@@ -182,12 +192,6 @@ float altitude = -1;
 #endif
 bool use_mcp4652 = true; // used on first version of PCB (<=1.3) to set MPPT and DCDC voltage
 
-enum ResParseChar {
-  RESP_OK,
-  RESP_ERROR,
-  RESP_COMPLETE
-};
-
 enum HW_Version{
   HW_unknown,
   HW_1_3,
@@ -213,6 +217,16 @@ enum BARO_CHIP{
   BARO_HP203B
 };
 
+BaroDriver* baro_for_chip(uint8_t chip){
+  switch(chip){
+    case BARO_BMP280: return &baro_bmp280;
+    case BARO_SPL06: return &baro_spl06;
+    case BARO_HP203B: return &baro_hp203b;
+    case BARO_BMP3xx: return &baro_bmp3xx;
+  }
+  return NULL;
+}
+
 // Sensor selction
 bool undervoltage = false;
 float reduce_interval_voltage = 3.5; // below this voltage the send inverval will be reduced to save energy
@@ -230,6 +244,9 @@ uint32_t gps_baud = 9600;
 BARO_CHIP baro_chip = BARO_NONE;
 uint32_t wind_age = WIND_AGE; 
 uint32_t gust_age = GUST_AGE;
+uint8_t gust_rank = GUST_RANK; // n-th highest gust within gust_age is sent
+uint8_t gust_percentile = 0; // 1..100: send this percentile of the gusts within gust_age instead of gust_rank
+uint8_t wind_mode = WIND_MODE_RANK; // WIND_MODE_WMO / _2MIN: standard means and 3 s gust instead of wind_age and gust_rank
 
 bool settings_ok = false;
 uint32_t next_baro_reading = 0;
@@ -246,7 +263,6 @@ uint32_t broadcast_scale_factor = 1; // multiplier for broadcast values. is set
 uint32_t last_wsxx_data = 0;
 uint32_t last_fnet_send = 0; // last package send
 uint32_t fanet_cooldown = 4000;
-uint32_t loopcounter = 0;
 
 // debugging
 bool test_with_usb = false;
@@ -260,6 +276,8 @@ bool skip_lora = false; // skip lora module init
 // Measurement values
 float baro_pressure = 0;
 float baro_temp = 0; // temp from bmp280, inside case/on pcb
+int16_t baro_pressure10 = 0; // 0.1 hPa, for the weather frame
+int16_t baro_temp10 = 0; // 0.1 °C
 int wind_dir_raw = 0;
 int wind_heading = 0;
 float wind_speed = 0;
@@ -289,6 +307,8 @@ uint32_t sleep_offset =0; //time passed since last increment of time(). used for
 
 // Function prototypes
 bool setup_flash();
+void setup_tasks();
+void build_frame_templates();
 void setup_usb_msc();
 DSTATUS disk_status(BYTE pdrv);
 DSTATUS disk_initialize(BYTE pdrv);
@@ -305,10 +325,16 @@ bool msc_writable_callback(void);
 // Helper ----------------------------------------------------------------------------------------------------------------------
 
 // get current millis since reset, including time spend in deepsleep. Missing time waiting for UART ws80 sensor
+// After a warm restart it continues from the time before the reset.
 uint32_t time(){
   return millis() + sleeptime_cum + sleep_offset;
 }
 
+// millis since this reset, including deepsleep. For the boot windows (USB detect, keep USB alive, error LED)
+uint32_t uptime(){
+  return time() - boot_time;
+}
+
 uint16_t get_fanet_id(){
   return UniqueID[0] + ((UniqueID[1])<<8);
 }
@@ -366,7 +392,7 @@ void i2c_scan(){
         DEBUGSER.print("0");
       DEBUGSER.println(address,HEX);
 
-      if(address == 0x2F){hw_version = HW_1_3;} // only HW1.3 has digipot
+      if(address == MCP4652_I2C_ADDR){hw_version = HW_1_3;} // only HW1.3 has digipot
  
       nDevices++;
     }
@@ -380,6 +406,11 @@ void i2c_scan(){
   if (nDevices == 0){DEBUGSER.println("No I2C devices found\n");}
 }
 
+bool i2c_probe(uint8_t address){
+  Wire.beginTransmission(address);
+  return Wire.endTransmission() == 0;
+}
+
 
 // read solderjumers one and disable pins again
 uint8_t read_id(){
@@ -395,69 +426,6 @@ uint8_t read_id(){
   return id;
 }
 
-// process line in 'key=value' format and hand to callback function
-bool process_line(char * in, int len, bool (*cb)(char*, char*)){
-  #define BUFFLEN 127
-  char name [BUFFLEN];
-  char value [BUFFLEN];
-  memset(name,'\0',BUFFLEN);
-  memset(value,'\0',BUFFLEN);
-  bool literal = false; // 
-  char* ptr = name; //start with name filed
-  int c = 0; // counter
-  int oc= 0; // output counter
-  bool cont = true; //continue flag
-
-  while (cont && (c < max(len,BUFFLEN)) && (oc < (BUFFLEN-1))){ // limit to 255 chars per line
-    if(in[c] < 127){
-      switch (in[c]) {
-        case '\r': if(c != 0) {cont = false;} break;
-        case '\n': cont = false; break;
-        //case '-': cont = false; break; // catches negative temps
-        case '>': cont = false; break;
-        case '!':  cont = false; break;
-        case '#':  cont = false; break;
-        case '?':  literal = true; break; // enable literal mode
-        case '=':  if(oc && (ptr == name) ){ *(ptr+oc) = '\0'; ptr = value; oc = 0;} break; // switch to value
-        case ' ':  if(!literal) {break;} // avoid removing whitespaces from name
-        default:   *(ptr+oc) = in[c]; oc++; break; // copy char
-      }
-    }
-    c++;
-  }
-  if(oc && (ptr == value)){ // value is set
-    return cb(name, value);
-  }
-  
-  return false;
-}
-
-
-// Set measurement value read from WS80 UART
-bool set_value(char* key,  char* value){
-  //printf("%s = %s\r\n",key, value);
-
-  if(strcmp(key,"WindDir")==0) {wind_dir_raw = atoi(value); add_wind_history_dir(wind_dir_raw); return false;}
-  if(strcmp(key,"WindSpeed")==0) {wind_speed = atof(value)*3.6; add_wind_history_wind(wind_speed); printf("%s = %0.2f\n",key, wind_speed); return false;}
-  if(strcmp(key,"WindGust")==0) {wind_gust = atof(value)*3.6; add_wind_history_gust(wind_gust); printf("%s = %0.2f\n",key, wind_gust); return false;}
-  if(strcmp(key,"Temperature")==0) {temperature = atof(value); if(!is_ws80){is_ws80=true; is_ws85=false; log_i("Detected WS80\n");} return false;} // WS80 only - autodetection
-  if(strcmp(key,"GXTS04Temp")==0) {temperature = atof(value);  if(!is_ws85){is_ws85=true; is_ws80=false; log_i("Detected WS85\n");} return false;} // WS85 only
-  if(strcmp(key,"Humi")==0) {humidity = atoi(value); return false;}
-  if(strcmp(key,"Light")==0) {light_lux = atoi(value); return false;}
-  if(strcmp(key,"UV_Value")==0) {uv_level = atof(value); return false;}
-  if(strcmp(key,"CapVoltage")==0) {cap_voltage = atof(value); return false;} // WS85
-  if(strcmp(key,"BatVoltage")==0) {
-    wsxx_vcc = atof(value); 
-    last_wsxx_data =time();
-    
-    log_i("WSXX data complete\r\n");
-    return true;
-  }
-
-  //log_i(" ->not_found\n");
-  return false;
-}
-
 #ifdef HAS_HEATER
 // Digipot, Solar & DCDC ----------------------------------------------------------------------------------------------------------------------
 
@@ -609,26 +577,12 @@ void read_batt_perc(){
 void baro_start_reading(){
   //sercom3.resetWIRE();
   //Wire.begin();
+  if(!baro){ return;}
   if(!next_baro_reading){
-    if(baro_chip == BARO_BMP280){ 
-      next_baro_reading = time() + bmp280.startMeasurment();
-    }
-    if(baro_chip == BARO_SPL06){ 
-      spl.start_measure();
-      next_baro_reading = time() + 27;
-    }
-    if(baro_chip == BARO_BMP3xx){ 
-      bmp3xx.setOutputDataRate(BMP3_ODR_50_HZ);
-    // bmp3xx.setTemperatureOversampling(BMP3_OVERSAMPLING_8X);
-    // bmp3xx.setPressureOversampling(BMP3_OVERSAMPLING_16X);
-    // bmp3xx.setIIRFilterCoeff(BMP3_IIR_FILTER_COEFF_3);
-      bmp3xx.performReading();
-      next_baro_reading = time() + 5;
-    }
-    if(baro_chip == BARO_HP203B){ 
-      hp.startMeasure();
-      next_baro_reading = time() + 100; //? check value
-    }
+    baro->start();
+    next_baro_reading = time() + baro->conversion_ms();
+    trace(TRACE_BARO_START, baro->conversion_ms());
+    task_schedule(TASK_BARO, next_baro_reading);
     } else {
       if(time() > (next_baro_reading +200)){
         next_baro_reading = 0;
@@ -639,53 +593,23 @@ void baro_start_reading(){
 // read value of baro, needs baro_start_reading in advance
 void read_baro(){
   bool data_ok = false;
-  double T,P;
-
-  if(baro_chip == BARO_BMP280){
-    if(next_baro_reading && (time() > next_baro_reading)){
-      uint8_t result = bmp280.getTemperatureAndPressure(T,P);
-      if(result!=0){
-        data_ok = true;
-      }
-    }
-  }
-
-  else if(baro_chip == BARO_SPL06){
-    if(next_baro_reading && (time() > next_baro_reading)){
-      P = spl.get_pressure();
-      T = spl.get_temp_c();
-      spl.sleep(); 
-      
-      if(P > 0){
-        data_ok = true;
-      }
-    }
-  }
-  else if(baro_chip == BARO_BMP3xx){ 
-    P = bmp3xx.pressure/100;
-    T = bmp3xx.temperature;
-    bmp3xx.setOutputDataRate(BMP3_ODR_0_001_HZ);
-    if(P > 0){data_ok = true;}
-  }
-  else if(baro_chip == BARO_HP203B){ 
+  float T,P;
 
-    hp.Measure_Pressure();
-    hp.Measure_Temperature();
-    hp.startMeasure();
-    P = hp.hp_sensorData.P;
-    T = hp.hp_sensorData.T;
-    if(P > 0){data_ok = true;}
+  if(baro && next_baro_reading && baro->ready()){
+    data_ok = baro->fetch(P, T);
   }
 
-
   if(data_ok){
     baro_temp = T;
     next_baro_reading = 0;
+    energy_add(ENERGY_BARO, baro->converted_ms);
     if (altitude > -1){
-        baro_pressure = (P * pow(1-(0.0065*altitude/(T + (0.0065*altitude) + 273.15)),-5.257));
+        baro_pressure = P * baro_sealevel_factor(altitude, T);
     } else {
       baro_pressure = P;
     }
+    baro_pressure10 = lroundf(baro_pressure*10); // scaled once per reading, not on every send
+    baro_temp10 = lroundf(T*10);
   } else {
     //log_i("Baro no data, retry\n");
     //baro_start_reading();
@@ -784,95 +708,6 @@ void read_wsdat(){
 //led_error(0);
 }
 
-// read UART and process input buffer, needs to be called periodically until new block is complete (last_ws80_data = time())
-// 2: data complete
-// 1: error
-// 0: data ok, continue
-int read_wsxx(){
-  #define BUFFERSIZE 1024 // size of linebuffer
-  static char buffer [BUFFERSIZE];
-  int co = 0;
-  bool found_data = false;
-  int eq_count = 0;
-  uint32_t last_data = micros();
-  //uint32_t cpy_last_wsxx_data = last_wsxx_data;
-  static uint32_t serial_wait = 3800;
-
-// Compare String 1
-  char comp1_arr[8] = {"FreqSel"};
-  const int comp1_len = 7;
-  int comp1_pos = 0;
-
-// Compare String 2
-  char comp2_arr[5];
-  if(is_ws85){ sprintf(comp2_arr,"WS85");}
-  else if(is_ws80){ sprintf(comp2_arr,"WH80");}
-  const int comp2_len = 4;
-  int comp2_pos = 0;
-
-  //uint32_t micros_start = micros();
-
-
-  while(micros()- last_data < serial_wait){ //  cpy_last_wsxx_data == last_wsxx_data &&
-    while (WSXX_UART.available()){
-      //led_error(1); // blink LED, for debugging
-      buffer[co] = WSXX_UART.read();
-      if(buffer[co] < 127){ // skip garbage
-        if(buffer[co] == '=') {eq_count++;} else {eq_count =0;}
-
-        if(buffer[co] == comp1_arr[comp1_pos]) {comp1_pos++;} 
-        else {comp1_pos=0;}
-
-        if(buffer[co] == comp2_arr[comp2_pos]) {comp2_pos++;} 
-        else {comp2_pos=0;}
-
-        if((comp1_pos == comp1_len) ||(comp2_pos == comp2_len)){ // if we found or pattern, increase wait time to get full block
-          found_data = true;
-          if(is_ws80){ serial_wait = 500;}
-          else if(is_ws85){ serial_wait = 3800;}
-        }
-
-        last_data = micros();
-        co++;
-
-
-        if(found_data && eq_count > 35) { // block ends with 37x =, if detected, lower wait time
-          serial_wait = 1;
-        }
-        
-        if(co >= BUFFERSIZE){
-          log_e("Buffer size exeeded\r\n");
-          co = 0;
-          //led_error(0);
-          return RESP_ERROR;
-        }
-      }
-    }
-    //led_error(0);
-  }
-
-// now parse buffer content
-if(found_data){
-  int i =0;
-  int pos = 0;
-  while (i < co){
-    if(buffer[i] == '\n'){
-          if(test_with_usb && usb_connected){
-            Serial.write(&buffer[pos], i-pos);
-          }
-          if(process_line(&buffer[pos], i-pos-1, &set_value)){
-            serial_wait = 120; // decrease value if one valid measuremnt was fount to dertimne if it is ws80 or ws85
-            return RESP_COMPLETE;
-          }
-      pos = i+1;
-    }
-    i++;
-
-  }
-}
-  return RESP_OK;
-}
-
 // Davis 6410 Sensor ----------------------------------------------------------------------------------------------------------------------
 int read_wind_dir(){
   int val = 0;
@@ -896,19 +731,32 @@ return val;
 }
 
 
-void calc_pulse_sensor(uint32_t pulses, uint32_t dmillis){
+// ps: captured pulse intervals of the same sleep, the gust is the fastest 3 s of them instead of the average
+void calc_pulse_sensor(uint32_t pulses, uint32_t dmillis, const PulseStats *ps){
   log_i("delta_t: ", dmillis);
   log_i("pulses: ", pulses); 
   wind_dir_raw = read_wind_dir();
   add_wind_history_dir(wind_dir_raw);
   
+  float gust = 0;
   if(is_davis6410){
     wind_speed = (float) pulses * 1.609 * (2250.0/((float)dmillis+1) ); // avoid div/0
+    gust = wind_speed;
+    if(ps && ps->count){
+      gust = max(ps->gust, wind_speed);
+      log_i("gust 3s: ", gust);
+      log_i("min interval [ticks]: ", ps->min_ticks);
+      if(debug_enabled){
+        printf("intervals: %u, histogram:", ps->count);
+        for(uint8_t i = 0; i < PULSE_HIST_BINS; i++){ printf(" %u", ps->hist[i]);}
+        printf("\n");
+      }
+    }
   }
   // ... other analog sensors
   add_wind_history_wind(wind_speed);
-  add_wind_history_gust(wind_speed);
-  save_history(wind_speed, temperature, humidity, light_lux, batt_volt, pv_charging, pv_done);
+  add_wind_history_gust(gust);
+  if(save_history(wind_speed, temperature, humidity, light_lux, batt_volt, pv_charging, pv_done)){ histlog_append();}
 }
 
 // Heater ----------------------------------------------------------------------------------------------------------------------
@@ -937,7 +785,7 @@ void run_heater(){
         batt_volt > 3.6 && \
         light_hist < 500 && \
         wind_hist < 10 && \
-        time() > 1800000) // min 30 min on
+        uptime() > 1800000) // min 30 min on
         || test_heater
         ){
           en_heater = true;
@@ -982,6 +830,7 @@ void run_heater(){
   // turn heater off if running
   } else {
     if(h_switch_on_time){
+      energy_add(ENERGY_HEATER, time() - h_switch_on_time);
       h_switch_on_time=0;
       current_output_v=0;
       digitalWrite(PIN_EN_HEATER,0);
@@ -1038,8 +887,8 @@ uint32_t sleep_til_serial_data(){
 
 // called after sleep
 void wakeup(){
+  energy_awake_begin();
   // USB->DEVICE.CTRLA.reg |= USB_CTRLA_ENABLE; // Re-enable USB, no need, not working?
-  loopcounter = 0;
   log_i("\r\n########\r\n");
   log_i("Wakeup: ", time()); 
   log_i("Wakeup_source: "); log_i(wakeup_source_string[wakeup_source]);log_i("\r\n");
@@ -1055,72 +904,7 @@ void wakeup(){
 
   read_batt_perc();
   sleep_allowed = time() + 100; // go back to sleep after 6 secs as fallback
-}
-
-// calc time to sleep til next fanet message needs to be send
-uint32_t calc_time_to_sleep(){
-  uint32_t tts_weather = -1;
-  uint32_t tts_name = -1;
-  uint32_t tts_info = -1;
-  uint32_t tts = 0;
-
-  if(batt_volt){
-    if(batt_volt < VBATT_LOW){
-      tts = 3600*500; // sleep 30min
-      undervoltage = true;
-      broadcast_scale_factor = 5;
-      log_i("Undervoltage\n");
-    } else if(batt_volt < reduce_interval_voltage){
-      reduced_interval = true;
-      broadcast_scale_factor = 3;
-      log_i("Low voltage\n");
-    } else {
-      // battery voltage is normal
-      reduced_interval = false;
-      broadcast_scale_factor = 1;
-    }
-
-
-  }
-  if(!undervoltage){
-    if( last_msg_weather && broadcast_interval_weather){
-      if( (last_msg_weather + (broadcast_interval_weather * broadcast_scale_factor)) > time() ){
-        tts_weather = (broadcast_interval_weather * broadcast_scale_factor) - (time()-last_msg_weather);
-      } else {
-        tts_weather = 0;
-      }
-    }
-    if( last_msg_name && broadcast_interval_name){
-      if( (last_msg_name + (broadcast_interval_name * broadcast_scale_factor)) > time()){
-        tts_name = (broadcast_interval_name * broadcast_scale_factor) - (time()-last_msg_name);
-      } else {
-        tts_name = 0;
-      }
-    }
-    if( last_msg_info && broadcast_interval_info){
-      if( (last_msg_info + (broadcast_interval_info * broadcast_scale_factor)) > time()){
-        tts_info = (broadcast_interval_info * broadcast_scale_factor) - (time()-last_msg_info);
-      }else {
-        tts_info = 0;
-      }
-    }
-    //log_i("tts_weather: ", tts_weather);
-    //log_i("tts_name: ", tts_name);
-    //log_i("tts_info: ", tts_info);
-    
-    tts = min(min(tts_name, tts_info), tts_weather);
-    if( fanet_cooldown && last_fnet_send  && (time() - last_fnet_send + tts < fanet_cooldown)){
-      tts += fanet_cooldown - (time()-last_fnet_send);
-    }
-    if(tts == (uint32_t)-1){ tts=0;}
-  }
-
-  if( !tts && loopcounter > 100){
-    log_e("just looping, will sleep\n");
-    tts = 12000;
-  }
-
-  return tts;
+  trace(TRACE_WAKEUP);
 }
 
 // RTC Handler callback, do not rename. gets called on rtc (timer) interrupt
@@ -1134,6 +918,8 @@ void RTC_Handler(void){
 // shut everything down, enable deepsleep
 void go_sleep(){
   uint32_t actual_sleep = 0;
+  energy_awake_end();
+  warm_seal();
 
   pinDisable(PIN_V_READ_TRIGGER);
 
@@ -1158,13 +944,14 @@ void go_sleep(){
   int32_t time_to_sleep = calc_time_to_sleep();
   if(!undervoltage){
     if(is_wsxx && last_wsxx_data == 0){ time_to_sleep = 12000;} // if no data from WS80 received 
-    if(is_davis6410){ time_to_sleep = min(time_to_sleep, sensor_integration_time);} // interval for gust detection 
+    if(is_davis6410){ time_to_sleep = min(time_to_sleep, min(sensor_integration_time, PULSE_RING_MS));} // interval for gust detection, pulse_ring must not wrap
     if(!settings_ok){ 
       log_e("No settings file\n");
       log_e("Sleeping forever\r\n");
       time_to_sleep = 0xFFFFFFF;
       } // if settings not ok sleep forever
   }
+  trace(TRACE_SLEEP_ENTER, time_to_sleep);
   if(!time_to_sleep){ return;} // if time_to_sleep = 0, do not sleep at all
 
   log_i("will sleep for ", time_to_sleep > 200000UL?-1: time_to_sleep);
@@ -1175,10 +962,11 @@ void go_sleep(){
     wdt_disable();
   }
 
-// Using TC4 for hardware pulsecounting on Falling edge on pin PA04 (D17). No interrupts needed.
+// Using TC4 for hardware pulsecounting on Falling edge on pin PA04 (D17), TC3 and the DMAC record the pulse intervals. No interrupts needed.
   if(!undervoltage && is_davis6410){ // pulse counting anemometer
     actual_sleep = rtc_sleep_cfg(time_to_sleep);
     setup_pulse_counter(); // need to setup GCLK6 before
+    setup_pulse_capture(pulse_ring, PULSE_RING_LEN); // intervals for the gust, TC3 + DMA
 
     if(debug_enabled){
       DEBUGSER.end();
@@ -1193,22 +981,31 @@ void go_sleep(){
       DEBUGSER.begin(115200*div_cpu);
     }
     sleeptime_cum += actual_sleep;
+    energy_add(ENERGY_SLEEP, actual_sleep);
     pulsecount = read_pulse_counter();
-    calc_pulse_sensor(pulsecount, actual_sleep);
+    bool wrapped;
+    uint16_t pos = read_pulse_capture(&wrapped);
+    PulseStats ps;
+    pulse_capture_stats(pos, wrapped, ps);
+    calc_pulse_sensor(pulsecount, actual_sleep, &ps);
     // elseif (is_other_pulsecounting_sensor){
-      //calc_...(pulsecount, actual_sleep);
+      //calc_...(pulsecount, actual_sleep, NULL);
     //}
 
 // UART sensor, just sleep
   } else if(!undervoltage && is_wsxx){ // no pulse counting anemometer, no interrupts
     int32_t t =0;
     int res = -1;
-    if(settings_ok && (time()> 2500)  && !usb_connected && !no_sleep && !testmode){
+    uint32_t t_total = 0; // counter ms, includes the UART reads
+    uint32_t t_uart = 0;
+    if(settings_ok && (uptime()> 2500)  && !usb_connected && !no_sleep && !testmode){
       reset_time_counter();
       actual_sleep = rtc_sleep_cfg(time_to_sleep);
       while(wakeup_source != WAKEUP_RTC){
         t = sleep_til_serial_data();
-        res = read_wsxx();
+        uint32_t uart_start = micros();
+        res = read_wsxx_dma(); // CPU idles while the block arrives by DMA
+        t_uart += (micros() - uart_start) * div_cpu / 1000; // SysTick runs on the divided clock
         if(res == RESP_COMPLETE){ // if true, we received a data block, so it is ok to sleep for ~ 4 seconds without listening to serial data
           if(time_to_sleep > t ){
             if(is_ws85){actual_sleep = rtc_sleep_cfg( min(time_to_sleep - t,8350));}
@@ -1223,12 +1020,17 @@ void go_sleep(){
               wakeup_source = WAKEUP_NONE; // reset wakeup reason
             }
             sleeptime_cum += t;
+            t_total += t;
             reset_time_counter();
           }
         }
       }
     t = read_time_counter();
     sleeptime_cum += t;
+    t_total += t;
+    t_uart = min(t_uart, t_total);
+    energy_add(ENERGY_SLEEP, t_total - t_uart);
+    energy_add(ENERGY_UART, t_uart);
     }
     sleep_offset = 0; // reset temporary offset
     
@@ -1236,6 +1038,7 @@ void go_sleep(){
     actual_sleep = rtc_sleep_cfg(time_to_sleep);
     sleep(false);
     sleeptime_cum += actual_sleep;
+    energy_add(ENERGY_SLEEP, actual_sleep);
   }
 
 // If sleep is disabled for debugging, use delay
@@ -1243,6 +1046,7 @@ void go_sleep(){
     log_i("INSOMNIA or Testmode enabled, unsing delay() instead of deepsleep\n");
     delay(time_to_sleep);
     sleeptime_cum += time_to_sleep;
+    energy_add(ENERGY_ACTIVE, time_to_sleep);
   }
 
 // re-enable wdt after sleep
@@ -1253,6 +1057,7 @@ void go_sleep(){
     div_cpu = div_cpu_fast;
     log_ser_begin();
   }
+  trace(TRACE_SLEEP_EXIT, wakeup_source);
   wakeup();
   if(test_with_usb){
     sleep_allowed = time() + time_to_sleep;
@@ -1279,6 +1084,9 @@ bool apply_setting(char* settingName,  char* settingValue){
   if(strcmp(settingName,"HEADING_OFFSET")==0) {heading_offset = atoi(settingValue); return 1;}
   if(strcmp(settingName,"GUST_AGE")==0) {gust_age = (uint32_t)atoi(settingValue)*1000; return 1;}
   if(strcmp(settingName,"WIND_AGE")==0) {wind_age = (uint32_t)atoi(settingValue)*1000; return 1;}
+  if(strcmp(settingName,"GUST_RANK")==0) {gust_rank = constrain(atoi(settingValue), 1, WIND_HIST_LEN); return 1;}
+  if(strcmp(settingName,"GUST_PERCENTILE")==0) {gust_percentile = constrain(atoi(settingValue), 0, 100); return 1;}
+  if(strcmp(settingName,"WIND_MODE")==0) {wind_mode = constrain(atoi(settingValue), WIND_MODE_RANK, WIND_MODE_2MIN); return 1;}
   
 // Broadcast intervals in seconds, 0 = disable
   if(strcmp(settingName,"BROADCAST_INTERVAL_WEATHER")==0) {broadcast_interval_weather = (uint32_t)atoi(settingValue)*1000; return 1;}
@@ -1309,14 +1117,124 @@ bool apply_setting(char* settingName,  char* settingValue){
 // Test commands
   if(strcmp(settingName,"TEST_HEATER")==0) {test_heater = atoi(settingValue); return 1;}
   if(strcmp(settingName,"SLEEP")==0) {usb_connected =false; return 1;}
-  if(strcmp(settingName,"FORMAT")==0) {if(format_flash()){NVIC_SystemReset();} else {log_i("Error Formating Flash\r\n");} return 1;}
+  if(strcmp(settingName,"ENERGY")==0) {if(atoi(settingValue)){energy_print();} else {energy_reset();} return 1;} // USB: ENERGY=1 print, ENERGY=0 reset counters
+  if(strncmp(settingName,"I_",2)==0 && energy_set_current(&settingName[2], atoi(settingValue))) {return 1;} // current of an energy phase in uA, e.g. I_SLEEP
+  if(strcmp(settingName,"BOOT")==0) {boot_print(); return 1;} // USB: BOOT=1 phase times of the last boot
+  if(strcmp(settingName,"TRACE")==0) {if(atoi(settingValue)){trace_dump();} else {trace_clear();} return 1;} // USB: TRACE=1 binary dump, TRACE=0 clear
+  if(strcmp(settingName,"FORMAT")==0) {if(format_flash()){reboot();} else {log_i("Error Formating Flash\r\n");} return 1;}
   if(strcmp(settingName,"RESET")==0) {setup(); return 1;}
   if(strcmp(settingName,"SKIP_LORA")==0) {skip_lora = true; return 1;}
   if(strcmp(settingName,"DELAY")==0) {delay(atoi(settingValue)); return 1;} // delay for WDT testing
-  if(strcmp(settingName,"REBOOT")==0) {NVIC_SystemReset(); return 1;}
+  if(strcmp(settingName,"REBOOT")==0) {reboot(); return 1;}
   return 0;
 }
 
+// values applied from the settings file, for the snapshot (settings.h)
+bool settings_capture(SettingsValues &v){
+  memset(&v, 0, sizeof(v)); // padding too, the snapshot is compared with memcmp
+  if(station_name.length() >= SETTINGS_NAME_LEN){ return false;}
+  strcpy(v.station_name, station_name.c_str());
+  v.pos_lat = pos_lat;
+  v.pos_lon = pos_lon;
+  v.altitude = altitude;
+#ifdef HAS_HEATER
+  v.is_heater = is_heater;
+  v.heater_voltage = heater_voltage;
+  v.mppt_voltage = mppt_voltage;
+#endif
+  v.reduce_interval_voltage = reduce_interval_voltage;
+  v.heading_offset = heading_offset;
+  v.gust_age = gust_age;
+  v.wind_age = wind_age;
+  v.gust_rank = gust_rank;
+  v.gust_percentile = gust_percentile;
+  v.wind_mode = wind_mode;
+  v.broadcast_interval_weather = broadcast_interval_weather;
+  v.broadcast_interval_name = broadcast_interval_name;
+  v.broadcast_interval_info = broadcast_interval_info;
+  v.is_baro = is_baro;
+  v.is_davis6410 = is_davis6410;
+  v.is_wsxx = is_wsxx;
+  v.is_ws80 = is_ws80;
+  v.is_ws85 = is_ws85;
+  v.sensor_integration_time = sensor_integration_time;
+  v.is_gps = is_gps;
+  v.gps_baud = gps_baud;
+  v.debug_enabled = debug_enabled;
+  v.errors_enabled = errors_enabled;
+  v.no_sleep = no_sleep;
+  v.test_with_usb = test_with_usb;
+  v.testmode = testmode;
+  v.use_wdt = use_wdt;
+  v.div_cpu_slow = div_cpu_slow;
+  v.forward_serial_while_usb = forward_serial_while_usb;
+  v.test_heater = test_heater;
+  v.skip_lora = skip_lora;
+  memcpy(v.energy_current, energy_current, sizeof(energy_current));
+  return true;
+}
+
+void settings_apply(const SettingsValues &v){
+  station_name = v.station_name;
+  pos_lat = v.pos_lat;
+  pos_lon = v.pos_lon;
+  altitude = v.altitude;
+#ifdef HAS_HEATER
+  is_heater = v.is_heater;
+  heater_voltage = v.heater_voltage;
+  mppt_voltage = v.mppt_voltage;
+#endif
+  reduce_interval_voltage = v.reduce_interval_voltage;
+  heading_offset = v.heading_offset;
+  gust_age = v.gust_age;
+  wind_age = v.wind_age;
+  gust_rank = v.gust_rank;
+  gust_percentile = v.gust_percentile;
+  wind_mode = v.wind_mode;
+  broadcast_interval_weather = v.broadcast_interval_weather;
+  broadcast_interval_name = v.broadcast_interval_name;
+  broadcast_interval_info = v.broadcast_interval_info;
+  is_baro = v.is_baro;
+  is_davis6410 = v.is_davis6410;
+  is_wsxx = v.is_wsxx;
+  is_ws80 = v.is_ws80;
+  is_ws85 = v.is_ws85;
+  sensor_integration_time = v.sensor_integration_time;
+  is_gps = v.is_gps;
+  gps_baud = v.gps_baud;
+  debug_enabled = v.debug_enabled;
+  errors_enabled = v.errors_enabled;
+  no_sleep = v.no_sleep;
+  test_with_usb = v.test_with_usb;
+  testmode = v.testmode;
+  use_wdt = v.use_wdt;
+  div_cpu_slow = v.div_cpu_slow;
+  forward_serial_while_usb = v.forward_serial_while_usb;
+  test_heater = v.test_heater;
+  skip_lora = v.skip_lora;
+  memcpy(energy_current, v.energy_current, sizeof(energy_current));
+}
+
+uint32_t settings_key(){
+  return settings_file_key((const uint8_t*)my_internal_storage.get_flash_address(), my_internal_storage.get_flash_size(), SETTINGSFILE_83);
+}
+
+// after parse_file() succeeded
+void settings_remember(){
+  SettingsValues v;
+  uint32_t key = settings_key();
+  if(key && settings_capture(v)){ settings_snapshot_save(key, v);}
+}
+
+// settings file unchanged since the last parse: take the snapshot
+bool settings_from_snapshot(){
+  SettingsValues v;
+  if(!settings_snapshot_load(settings_key(), v)){ return false;}
+  settings_apply(v);
+  log_i("Settings from snapshot\r\n");
+  return true;
+}
+
 void print_settings(){
   if(debug_enabled){
     log_i("Name: "); log_i(station_name.c_str()); log_i("\r\n");
@@ -1478,6 +1396,8 @@ void read_serial_cmd(){
     co++;
   }
   if(ok){
+    setup_tasks(); // intervals may have changed
+    build_frame_templates(); // NAME, LAT, LON
     // Apply new mppt voltage
   #ifdef HAS_HEATER
     mcp4652_write(WRITE_WIPER_MPPT, calc_cn3791(mppt_voltage));
@@ -1489,13 +1409,63 @@ void read_serial_cmd(){
 }
 
 // Send ----------------------------------------------------------------------------------------------------------------------
+// Frames are assembled in a static buffer, the radio transmits from it asynchronously. Constant parts are built by
+// build_frame_templates() when the settings are loaded, a send only copies them and fills in the measurement values.
+#define FANET_TX_MAX 64 // largest frame we send: 4 byte header + name (truncated) or info string
+uint8_t tx_frame[FANET_TX_MAX];
+uint8_t weather_template[sizeof(fanet_packet_t4)]; // header and position
+uint8_t name_frame[FANET_TX_MAX];
+uint8_t name_frame_len = 0;
+fanet_header info_header;
+
+void build_fanet_header(fanet_header *header, uint8_t type){
+  header->type = type;
+  header->vendor = FANET_VENDOR_ID;
+  header->forward = false;
+  header->ext_header = false;
+  header->address = get_fanet_id();
+}
+
+// rebuild if the position changes
+void build_weather_template(){
+  memset(weather_template, 0, sizeof(weather_template));
+  pack_weatherdata_header((fanet_packet_t4 *)weather_template, FANET_VENDOR_ID, get_fanet_id(), fanet_encode_lat(pos_lat), fanet_encode_lon(pos_lon));
+}
+
+void build_frame_templates(){
+  build_weather_template();
+
+  fanet_header header;
+  build_fanet_header(&header, 2);
+  int len = min((int)station_name.length(), FANET_TX_MAX - 4);
+  memcpy(name_frame, (uint8_t*)&header, 4);
+  memcpy(&name_frame[4], station_name.c_str(), len);
+  name_frame_len = len + 4;
+
+  build_fanet_header(&info_header, 3);
+}
 
 void send_msg_weather(){
   led_status(1);
-  WindSample current_wind = get_wind_from_hist(wind_age);
-  wind_gust = get_gust_from_hist(gust_age);
-  wind_speed = current_wind.wind/10.0;
-  wind_dir_raw = current_wind.dir_raw;
+  uint16_t wind10, gust10;
+  if(wind_mode != WIND_MODE_RANK){
+    WmoWind w = wmo_get(wind_mode == WIND_MODE_2MIN);
+    wind10 = w.wind10;
+    gust10 = w.gust10;
+    wind_dir_raw = w.dir_raw;
+    log_i("Dir sigma: ", w.sigma);
+  } else {
+    WindSample current_wind = get_wind_from_hist(wind_age);
+    if(gust_percentile){
+      gust10 = get_gust10_percentile_from_hist(gust_age, gust_percentile);
+    } else {
+      gust10 = get_gust10_from_hist(gust_age, gust_rank);
+    }
+    wind10 = current_wind.wind;
+    wind_dir_raw = current_wind.dir_raw;
+  }
+  wind_speed = wind10/10.0;
+  wind_gust = gust10/10.0;
   wind_heading = wind_dir_raw + heading_offset;
   if(wind_heading > 359){ wind_heading -=360;}
   if(wind_heading < 0){ wind_heading +=360;}
@@ -1503,70 +1473,65 @@ void send_msg_weather(){
   if(is_davis6410){ // no other temp sensor
     temperature= baro_temp;
   } 
-  if( wind_speed > (wind_gust +3)){
+  if( wind10 > (gust10 + 30)){
     // return;
+    gust10 = wind10;
     wind_gust = wind_speed;
     log_i("adapting gust speed\r\n");
   }
 
-  weatherData wd;
-  wd.vid = FANET_VENDOR_ID;
-  wd.fanet_id = get_fanet_id();
-  wd.lat = pos_lat;
-  wd.lon = pos_lon;
+  weatherDataFixed wd;
   wd.bWind = true;
-  wd.wHeading = wind_heading;
-  wd.wSpeed = wind_speed;
-  wd.wGust = wind_gust;      
+  wd.heading = wind_heading;
+  wd.speed10 = wind10;
+  wd.gust10 = gust10;
   wd.bTemp = true;
-  wd.temp = temperature;
+  wd.temp10 = is_davis6410 ? baro_temp10 : temperature10;
 
-  if(is_wsxx){
-    wd.bHumidity = true;
-    wd.Humidity = humidity;
-  }
+  wd.bHumidity = is_wsxx;
+  wd.humidity = humidity;
 
+  wd.bBaro = true; // baro is required to forward data in OGN
   if(is_baro){
-    wd.bBaro = true;
-    wd.Baro = baro_pressure;  
+    wd.baro10 = baro_pressure10;
   } else {
-    wd.bBaro = true; // baro is required to forward data in OGN
-    wd.Baro = -1;  
+    wd.baro10 = -10; // -1 hPa
   }
   wd.bStateOfCharge = true;
-  wd.Charge = batt_perc;
+  wd.charge = batt_perc;
 
   if(testmode){
     wd.bBaro = true;
-    wd.Baro = baro_pressure;  
-    wd.wHeading = 123;
-    wd.wSpeed = 5;
-    wd.wGust = 7;      
-    wd.temp = 10;
-    wd.Humidity = 15;
+    wd.baro10 = baro_pressure10;
+    wd.heading = 123;
+    wd.speed10 = 50;
+    wd.gust10 = 70;
+    wd.temp10 = 100;
+    wd.humidity = 15;
     log_i("\r\nTESTMODE - Fake values\r\n");
   }
 
   log_i("\r\nSending Weather\r\n");
 
   int msgSize = sizeof(fanet_packet_t4);
-  uint8_t* buffer = new uint8_t[msgSize];
-  pack_weatherdata(&wd, buffer);
+  memcpy(tx_frame, weather_template, msgSize);
+  pack_weatherdata_values(&wd, tx_frame);
 
 // write buffer content to console
 #if 0
   for (int i = 0; i< msgSize; i++){
-    printf("%02X ", (buffer)[i]);
+    printf("%02X ", (tx_frame)[i]);
   }
   Serial1.println();
 #endif
 
   radio_phy->standby();
-  radio_phy->startTransmit(buffer, msgSize);
+  radio_phy->startTransmit(tx_frame, msgSize);
+  trace(TRACE_TX_START, msgSize);
 
   print_data();
   led_status(0);
-  save_history(wind_speed, temperature, humidity, light_lux, batt_volt, pv_charging, pv_done); // only save history on send
+  if(save_history(wind_speed, temperature, humidity, light_lux, batt_volt, pv_charging, pv_done)){ histlog_append();} // only save history on send
   
 }
 
@@ -1616,6 +1581,7 @@ void read_gps(){
         pos_lon = tinyGps.location.lng();
         altitude = tinyGps.altitude.meters();
         last_gps_valid = time();
+        build_weather_template();
         //DEBUGSER.println("Position Update");
     }
   }
@@ -1629,93 +1595,189 @@ bool fanet_cooldown_ok(){
   return false;
 }
 
-void send_msg_name(const char* name, int len){
-  uint8_t* buffer = new uint8_t[len+4];
-  fanet_header header;
-  header.type = 2;
-  header.vendor = FANET_VENDOR_ID;
-  header.forward = false;
-  header.ext_header = false;
-  header.address = get_fanet_id();
-
-  memcpy(buffer, (uint8_t*)&header, 4);
-  memcpy(&buffer[4], name, len);
+void send_msg_name(){
+  memcpy(tx_frame, name_frame, name_frame_len);
 
 // write buffer content to console
 #if 0
-  for (int i = 0; i< len+4; i++){
-    printf("%02X ", (buffer)[i]);
+  for (int i = 0; i< name_frame_len; i++){
+    printf("%02X ", (tx_frame)[i]);
   }
   Serial1.println();
 #endif
 
   radio_phy->standby();
-  radio_phy->startTransmit((uint8_t*) buffer, len+4);
+  radio_phy->startTransmit(tx_frame, name_frame_len);
+  trace(TRACE_TX_START, name_frame_len);
 }
 
 void send_msg_info(){
-  char data[50] = {0x00};
-  uint8_t data_len = 1;
+  memcpy(tx_frame, (uint8_t*)&info_header, 4);
+  tx_frame[4] = 0x00;
+  int data_len;
+  if(boot_report_pending){ // once after boot: phase times of setup()
+    data_len = snprintf((char*)&tx_frame[5], FANET_TX_MAX - 5, "%04X:%s ", get_fanet_id(), VERSION);
+    data_len = 1 + data_len + boot_format((char*)&tx_frame[5 + data_len], FANET_TX_MAX - 5 - data_len);
+    boot_report_pending = false;
+  } else {
   // Test: send battery voltage and charging state
-  data_len += sprintf(&data[1], "%04X:%s %0.2fV C%i", get_fanet_id(), VERSION, batt_volt, pv_charging);
-
-
-  uint8_t* buffer = new uint8_t[data_len+4];
-  fanet_header header;
-  header.type = 3;
-  header.vendor = FANET_VENDOR_ID;
-  header.forward = false;
-  header.ext_header = false;
-  header.address = get_fanet_id();
-
-  memcpy(buffer, (uint8_t*)&header, 4);
-  memcpy(&buffer[4], data, data_len);
+    data_len = 1 + snprintf((char*)&tx_frame[5], FANET_TX_MAX - 5, "%04X:%s %0.2fV C%i %luuA", get_fanet_id(), VERSION, batt_volt, pv_charging, (unsigned long)energy_avg_ua());
+  }
+  data_len = min(data_len, FANET_TX_MAX - 5); // snprintf returns the untruncated length
 
 // write buffer content to console
 #if 1
   for (int i = 0; i< data_len+4; i++){
-    printf("%02X ", (buffer)[i]);
+    printf("%02X ", (tx_frame)[i]);
   }
   Serial1.println();
 #endif
   log_i("Sending Info Msg\n");
   radio_phy->standby();
-  radio_phy->startTransmit((uint8_t*) buffer, data_len+4);
+  radio_phy->startTransmit(tx_frame, data_len+4);
+  trace(TRACE_TX_START, data_len+4);
 }
 
 
-bool radio_init(){
-  if(skip_lora){return false;}
-    if(radio_sx1276.begin(868.2, 250, 7, 5, LORA_SYNCWORD, 10, 12, 0) == RADIOLIB_ERR_NONE){
+bool radio_begin(LORA_MODULE module){
+  switch(module){
+    case LORA_SX1276:
+      if(radio_sx1276.begin(868.2, 250, 7, 5, LORA_SYNCWORD, 10, 12, 0) != RADIOLIB_ERR_NONE){ return false;}
       radio_phy = (PhysicalLayer*)&radio_sx1276;
       log_i("Found LoRa SX1276\n");
-      lora_module = LORA_SX1276;
-      return true;
-    } 
-    if(radio_llcc68.begin(868.2, 250, 7, 5, LORA_SYNCWORD, 10, 12) == RADIOLIB_ERR_NONE){
+      break;
+    case LORA_LLCC68:
+      if(radio_llcc68.begin(868.2, 250, 7, 5, LORA_SYNCWORD, 10, 12) != RADIOLIB_ERR_NONE){ return false;}
       radio_phy = (PhysicalLayer*)&radio_llcc68;
       log_i("Found LoRa LLCC68\n");
-      lora_module = LORA_LLCC68;
-      return true;
-    }
-    if(radio_sx1262.begin(868.2, 250, 7, 5, LORA_SYNCWORD, 10, 12) == RADIOLIB_ERR_NONE){
+      break;
+    case LORA_SX1262:
       // NiceRF SX1262 issue https://github.com/jgromes/RadioLib/issues/689
+      if(radio_sx1262.begin(868.2, 250, 7, 5, LORA_SYNCWORD, 10, 12) != RADIOLIB_ERR_NONE){ return false;}
       radio_phy = (PhysicalLayer*)&radio_sx1262;
       log_i("Found LoRa SX1262\n");
-      lora_module = LORA_SX1262;
-      return true;
-    }  else {
-        log_i("No LoRa found\n");
-        return false;
+      break;
+    default:
+      return false;
+  }
+  lora_module = module;
+  return true;
+}
+
+// the module of the hardware inventory first, then probe in this order
+bool radio_init(){
+  if(skip_lora){return false;}
+  LORA_MODULE known = hwinv_valid() ? (LORA_MODULE)hwinv.lora_module : LORA_NONE;
+  if(known != LORA_NONE && radio_begin(known)){ return true;}
+  const LORA_MODULE probe[] = {LORA_SX1276, LORA_LLCC68, LORA_SX1262};
+  for(uint8_t i = 0; i < sizeof(probe)/sizeof(probe[0]); i++){
+    if(probe[i] != known && radio_begin(probe[i])){ return true;}
+  }
+  log_i("No LoRa found\n");
+  return false;
+}
+
+
+// Tasks ----------------------------------------------------------------------------------------------------------------------
+#define WEATHER_RETRY 50 // ms until the first retry if the weather data is not ready yet (baro conversion)
+#define WEATHER_RETRY_MAX TASK_IDLE_SLEEP // doubled per retry up to this (GPS without fix, no sensor data)
+uint32_t weather_retry = WEATHER_RETRY;
+
+void task_send_name(){
+  if(station_name.length() > 1){
+    led_status(1);
+    send_msg_name();
+    log_i("Send name: "); log_i(station_name.c_str()); log_i("\r\n");
+    last_fnet_send = time();
+    last_msg_name = time();
+    send_active = time();
+    led_status(0);
+  }
+}
+
+void task_send_weather(){
+  if( allowed_to_send_weather() ){
+    send_msg_weather();
+    last_fnet_send = time();
+    last_msg_weather = time();
+    send_active = time();
+    weather_retry = WEATHER_RETRY;
+  } else {
+    if(is_wsxx && last_wsxx_data && (time()- last_wsxx_data > 9000)){
+      log_e("Wdata not ready. Sleep\r\n");
+      sleep_allowed = time() + 1;
+      last_wsxx_data = 0;
     }
+    task_schedule(TASK_WEATHER, time() + weather_retry);
+    weather_retry = min(weather_retry * 2, (uint32_t)WEATHER_RETRY_MAX);
+  }
 }
 
+void task_send_info(){
+  led_status(1);
+  send_msg_info();
+  last_fnet_send = time();
+  last_msg_info = time();
+  send_active = time();
+  led_status(0);
+}
+
+// one shot, queued by baro_start_reading() for the end of the conversion
+void task_read_baro(){
+  if(!is_baro){ return;}
+  read_baro();
+  if(next_baro_reading){ // no data yet
+    task_schedule(TASK_BARO, time() + 5);
+  }
+}
+
+#ifdef HAS_HEATER
+void task_heater(){
+  if(is_heater && (hw_version == HW_1_3)){run_heater();}
+}
+#endif
+
+// Settings not ok. Try few times, then sleep
+void task_settings_retry(){
+  if(!sleep_allowed){
+    sleep_allowed = time() + 180000UL; // Sleep after 3 minutes
+  }
+  log_e("\r\nFailed to obtain settings from file. Trying again\r\n");
+  settings_ok = parse_file(SETTINGSFILE);
+  if(settings_ok){
+    settings_remember();
+    reboot();      // processor software reset
+  }
+}
+
+// register the periodic work, called after the settings are read
+void setup_tasks(){
+  tasks_init();
+  task_register(TASK_WEATHER, task_send_weather, broadcast_interval_weather, TASK_SCALED | TASK_RADIO | TASK_WAKE);
+  task_register(TASK_NAME, task_send_name, broadcast_interval_name, TASK_SCALED | TASK_RADIO | TASK_WAKE);
+  task_register(TASK_INFO, task_send_info, broadcast_interval_info, TASK_SCALED | TASK_RADIO | TASK_WAKE);
+  task_register(TASK_BARO, task_read_baro, 0, 0);
+  task_register(TASK_SETTINGS, task_settings_retry, 15000, 0);
+
+  if(lora_module){ // without radio the messages never get due
+    // from the last sends (kept over a warm restart), so a restart or a new setting does not shift the rhythm
+    if(broadcast_interval_weather){ task_schedule(TASK_WEATHER, task_first_deadline(TASK_WEATHER, last_msg_weather));}
+    if(broadcast_interval_name){ task_schedule(TASK_NAME, task_first_deadline(TASK_NAME, last_msg_name));}
+    if(broadcast_interval_info){ task_schedule(TASK_INFO, task_first_deadline(TASK_INFO, last_msg_info));}
+  }
+#ifdef HAS_HEATER
+  task_register(TASK_HEATER, task_heater, 1000, 0);
+  if(is_heater && (hw_version == HW_1_3)){ task_schedule(TASK_HEATER, time());}
+#endif
+  if(!settings_ok){ task_schedule(TASK_SETTINGS, time() + 15000);}
+}
 
 // Setup ----------------------------------------------------------------------------------------------------------------------
 
 extern uint32_t __etext;
 
 void setup(){
+  boot_begin();
   DEBUGSER.begin(115200); // on boot start with 48Mhz clock
 
   printf_init(DEBUGSER);
@@ -1729,24 +1791,45 @@ void setup(){
   //printf("flash_size: %lu\n", my_internal_storage.get_flash_size());
 
   hw_version = HW_2_0; 
+  uint8_t inv_baro = BARO_NONE; // baro chip for the inventory, the known one if not probed
   Wire.begin();
-  i2c_scan();
+  if(hwinv_load()){ // known hardware, no sweep
+    if(i2c_probe(MCP4652_I2C_ADDR)){ hw_version = HW_1_3;}
+  } else {
+    i2c_scan();
+  }
+  boot_phase(BOOT_I2C_SCAN);
+  if(hwinv_valid()){ inv_baro = hwinv.baro_chip;}
 
-  setup_display();
+  if(!hwinv_valid() || hwinv.display || i2c_probe(SCREEN_ADDRESS)){
+    setup_display();
+  }
   if(display_present()){
     log_i("I2C Display enabled\n");
   }
+  boot_phase(BOOT_DISPLAY);
   
   //printf("FANET ID: %02X%04X\r\n",fmac.myAddr.manufacturer,fmac.myAddr.id);
-  if(setup_flash()){
+  if(settings_from_snapshot()){ // no mount and parse, the FAT is only needed for USB
+    settings_ok = true;
+    boot_phase(BOOT_SETTINGS);
+    setup_usb_msc();
+    flash.begin();
+    boot_phase(BOOT_FLASH);
+  } else if(setup_flash()){
+    boot_phase(BOOT_FLASH);
     settings_ok = parse_file(SETTINGSFILE);
-    if(!debug_enabled){
-      DEBUGSER.println("Debug messages disabled");
-      DEBUGSER.flush();
-      DEBUGSER.end();
-      pinDisable(PIN_RX);
-      pinDisable(PIN_TX);
-    }
+    if(settings_ok){ settings_remember();}
+    boot_phase(BOOT_SETTINGS);
+  } else {
+    boot_phase(BOOT_FLASH);
+  }
+  if(!debug_enabled){
+    DEBUGSER.println("Debug messages disabled");
+    DEBUGSER.flush();
+    DEBUGSER.end();
+    pinDisable(PIN_RX);
+    pinDisable(PIN_TX);
   }
 
   if(radio_init()){
@@ -1756,6 +1839,7 @@ void setup(){
     led_error(1);
     display_delay(2000);
   }
+  boot_phase(BOOT_RADIO);
 
 
   if(settings_ok){
@@ -1765,41 +1849,31 @@ void setup(){
     if(altitude > -1){
       station_name += " (" + String(int(altitude)) + "m)"; // Testation (1234m)
     }
+    build_frame_templates();
     setup_PM(is_wsxx); // powermanagement add || other sensors using 32bit counter
     wdt_enable(WDT_PERIOD,false); // setup clocks
     if(!use_wdt) {
       wdt_disable();
     }
+    boot_phase(BOOT_PM);
   if(is_baro){
-    bool baro_ok = false;
-
+    BaroDriver *known = hwinv_valid() ? baro_for_chip(hwinv.baro_chip) : NULL;
+    if(known && known->begin()){ baro = known; baro_chip = (BARO_CHIP)hwinv.baro_chip;}
     // ToDo: Crashes with HP203B installed when checking for bmp3xx
-    //if(!baro_ok && bmp280.begin()){ //0x76
-    //  baro_ok = true;
-    //  baro_chip = BARO_BMP280;
-    //  log_i("Baro: BMP280\r\n");
-    //  bmp280.setOversampling(4);
-    //}
-    //if(!baro_ok && spl.begin(0x77)){
-    //  baro_ok = true;
-    //  baro_chip = BARO_SPL06;
-    //  log_i("Baro: SPL06\r\n");
-    //}
-    //if(!baro_ok && bmp3xx.begin_I2C(0x76)){
-    //  baro_ok = true;
-    //  baro_chip = BARO_BMP3xx;
-    //  log_i("Baro: BMP3XX\r\n");
-    //}
-    if(!baro_ok && hp.begin(0x76, OSR_2048)){
-        baro_ok = true;
-        baro_chip = BARO_HP203B;
-        log_i("Baro: HP203B\r\n");
+    //if(!baro && baro_bmp280.begin()){ baro = &baro_bmp280; baro_chip = BARO_BMP280;}
+    //if(!baro && baro_spl06.begin()){ baro = &baro_spl06; baro_chip = BARO_SPL06;}
+    //if(!baro && baro_bmp3xx.begin()){ baro = &baro_bmp3xx; baro_chip = BARO_BMP3xx;}
+    if(!baro && baro_hp203b.begin()){ baro = &baro_hp203b; baro_chip = BARO_HP203B;}
+    if(baro){
+      log_i("Baro: "); log_i(baro->name()); log_i("\r\n");
     }
-    if(!baro_ok){
+    if(!baro){
       log_e("Baro: not found\r\n");
       is_baro = false;
       led_error(1);
     }
+    inv_baro = baro_chip;
+    boot_phase(BOOT_BARO);
   }
   
 #ifdef HAS_HEATER
@@ -1816,6 +1890,7 @@ hw_version = HW_2_0;
     wdt_enable(WDT_PERIOD,false); // setup clocks
     wdt_disable();
     //setup_rtc_time_counter();
+    boot_phase(BOOT_PM);
   }
 
   if(is_wsxx){
@@ -1828,20 +1903,35 @@ hw_version = HW_2_0;
     log_i("Starting GPS with baud: ", gps_baud);
   }
 
-// init history array
-  for( int i = 0; i< HISTORY_LEN; i++){
-    history[i].set = false;
-  }
-  for( int i=0; i< WIND_HIST_LEN; i++){
-    wind_history[i].time = 0;
-    wind_history[i].gust = 0;
-    wind_history[i].dir_raw = 0;
-    wind_history[i].wind = 0;
+// init history array, unless a warm restart kept it
+  if(warm_restore()){
+    histlog_restore(false);
+    wmo_rebuild();
+    log_i("Warm restart, time: ", time());
+  } else {
+    for( int i = 0; i< HISTORY_LEN; i++){
+      history[i].set = false;
+    }
+    hist_count = 0;
+    histlog_restore();
+    for( int i=0; i< WIND_HIST_LEN; i++){
+      wind_history[i].time = 0;
+      wind_history[i].gust = 0;
+      wind_history[i].dir_raw = 0;
+      wind_history[i].wind = 0;
+    }
+    wind_hist_pos = 0;
   }
+  wind_windows_reset();
   // create_versionfile(VERSIONFILE); // create version file if not exists (not working)
   if(hw_version == HW_unknown){log_i("Hardware detection failed\n");}
   if(hw_version == HW_1_3){log_i("Detected HW1.x\n");}
   if(hw_version == HW_2_0){log_i("Detected HW2.x\n");}
+  setup_tasks();
+  if(lora_module){ task_schedule(TASK_INFO, time());} // boot profile once, then every broadcast_interval_info
+  hwinv_save(hw_version, skip_lora && hwinv_valid() ? hwinv.lora_module : lora_module, inv_baro, display_present());
+  boot_end();
+  if(debug_enabled){ boot_print();}
   log_flush();
   wakeup();
 }
@@ -1850,15 +1940,11 @@ hw_version = HW_2_0;
 
 void loop(){
 
-static uint32_t send_active=0; // if > 0, time() last message was send to tx queue, reset to 0 if send is complete
-static uint32_t last_settings_check = 0; // timee() ckecked if a settings file is present if settings not read yet sucessfully
 
 // print millis as alive counter
 static uint32_t last_call = 0;
 static bool s = false;
 
-loopcounter++;
-
 if(last_call && (time()-last_call > 15)){
   if(!s){led_status(0);}
 }
@@ -1876,54 +1962,17 @@ if(usb_connected && time()-last_call > 500){
 
 
 
-#ifdef HAS_HEATER
-  if(is_heater && (hw_version == HW_1_3)){run_heater();}
-#endif
-
-  if(is_baro){read_baro();}
   if(is_gps){read_gps();}
 
-  if(fanet_cooldown_ok() && broadcast_interval_name && ( (time()- last_msg_name) > (broadcast_interval_name* broadcast_scale_factor)) ){ // once a hour
-    if(station_name.length() > 1){
-      led_status(1);
-      send_msg_name(station_name.c_str(),station_name.length());
-      log_i("Send name: "); log_i(station_name.c_str()); log_i("\r\n");
-      last_fnet_send = time();
-      last_msg_name = time();
-      send_active = time();
-      led_status(0);
-    }
-  }
-
-  if(fanet_cooldown_ok() && broadcast_interval_weather && ( (time()- last_msg_weather) > (broadcast_interval_weather * broadcast_scale_factor)) ){
-    if( allowed_to_send_weather() ){
-      send_msg_weather();
-      last_fnet_send = time();
-      last_msg_weather = time();
-      send_active = time();
-    } else {
-      if(is_wsxx && last_wsxx_data && (time()- last_wsxx_data > 9000)){
-        log_e("Wdata not ready. Sleep\r\n");
-        sleep_allowed = time() + 1;
-        last_wsxx_data = 0;
-      }
-      
-    }
-  }
-  if(broadcast_interval_info && fanet_cooldown_ok() && ( (time()- last_msg_info) > (broadcast_interval_info * broadcast_scale_factor)) ){
-      led_status(1);
-      send_msg_info();
-      last_fnet_send = time();
-      last_msg_info = time();
-      send_active = time();
-      led_status(0);
-  }
+  tasks_run(); // weather, name, info, baro, heater, settings retry
 
   if(send_active){
     if( (time()- send_active > (3500))){
       led_error(1);
       log_i("Send timed out\r\n");
       led_status(0);
+      energy_add(ENERGY_TX, time() - send_active);
+      trace(TRACE_TX_TIMEOUT, time() - send_active);
       send_active =0;
       sleep_allowed = time() + (1);
       radio_phy->sleep();
@@ -1934,6 +1983,8 @@ if(usb_connected && time()-last_call > 500){
     if(transmittedFlag){
       transmittedFlag = false;
       //log_i("Send complete\r\n");
+      energy_add(ENERGY_TX, time() - send_active);
+      trace(TRACE_TX_DONE, time() - send_active);
       send_active = 0;
       sleep_allowed = time() + (1);
       radio_phy->finishTransmit();
@@ -1942,41 +1993,29 @@ if(usb_connected && time()-last_call > 500){
   }
 
 // Check if everything is done --> sleep
-  if(!send_active && sleep_allowed && (time() > sleep_allowed) && (!usb_connected || test_with_usb) && (time() > 2500)){ // allow sleep after 2500 ms to get a change to detect usb connected
+  if(!send_active && sleep_allowed && (time() > sleep_allowed) && (!usb_connected || test_with_usb) && (uptime() > 2500)){ // allow sleep after 2500 ms to get a change to detect usb connected
     go_sleep();
   }
 
-  if(!settings_ok){ // Settings not ok. Try few times, then sleep
-    if(!sleep_allowed){ 
-      sleep_allowed = time() + 180000UL; // Sleep after 3 minutes
-    }
-    if(time()- last_settings_check > 15000){
-      last_settings_check = time();
-      log_e("\r\nFailed to obtain settings from file. Trying again\r\n");
-      settings_ok = parse_file(SETTINGSFILE);
-      if(settings_ok){ 
-        NVIC_SystemReset();      // processor software reset
-        }
-    }
-  }
-
   // during Dev
   if(usb_connected){
     if(test_with_usb){read_wsxx();} // to simulate normal behavior without sleep read and parse data from serial port
     else {forward_wsxx_serial();} // otherwise just forward the data
     read_serial_cmd(); // read setting values from serial for testing
-    if(!no_sleep && !test_with_usb && (time() > 15UL*60UL*1000UL)){
+    if(!no_sleep && !test_with_usb && (uptime() > 15UL*60UL*1000UL)){
       log_i("Restart\r\n");
       log_flush();
       usb_connected = false;
-      NVIC_SystemReset();
+      reboot();
       } // keep usb alive for 15 min
   }
 
-  if((time() > 5UL*60UL*1000UL)){ // trun off error LED after 5minutes to save energy if an error occures with no one around
+  if((uptime() > 5UL*60UL*1000UL)){ // trun off error LED after 5minutes to save energy if an error occures with no one around
     led_error(0);
   }
 
+  if(hist_dirty){ warm_seal();} // the new reading survives a watchdog reset
+
   if(use_wdt){
     wdt_reset();
   }
@@ -2063,10 +2102,8 @@ int32_t msc_read_cb (uint32_t lba, void* buffer, uint32_t bufsize){
 // return number of written bytes (must be multiple of block size)
 int32_t msc_write_cb (uint32_t lba, uint8_t* buffer, uint32_t bufsize){
   //Serial.printf("Writing at %d with size %d\n",lba,bufsize);
-  // Erase should be done before every writing to the flash
-  my_internal_storage.erase(lba*DISK_BLOCK_SIZE, bufsize);
-  // Write to the flash
-  my_internal_storage.write(lba*DISK_BLOCK_SIZE, buffer, bufsize);
+  // Erases and writes only the rows that changed, hosts rewrite unchanged blocks a lot
+  my_internal_storage.program(lba*DISK_BLOCK_SIZE, buffer, bufsize);
   return bufsize;
 }
 
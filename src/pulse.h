@@ -0,0 +1,68 @@
+#pragma once
+#include <Arduino.h>
+
+// Davis 6410 pulse intervals: during sleep TC3 captures the ticks between two reed pulses and the DMAC stores them in
+// pulse_ring (see setup_pulse_capture()). After the wake pulse_capture_stats() gets the 3 s gust, the shortest interval
+// and a histogram of the intervals from it, so the gust no longer depends on the sensor integration time.
+
+#define PULSE_RING_LEN 768
+#define PULSE_TICKS_PER_S 1024 // GCLK6
+#define PULSE_GUST_TICKS (3 * PULSE_TICKS_PER_S)
+#define PULSE_KMH_TICKS (2.25 * 1.609 * PULSE_TICKS_PER_S) // 1 pulse/s = 2.25 mph
+#define PULSE_MAX_KMH 200
+// longest sleep without a wrap at PULSE_MAX_KMH (13.9 s), go_sleep() caps the sensor integration time to it. The first
+// capture is not an interval.
+#define PULSE_RING_MS ((uint32_t)((PULSE_RING_LEN - 1) * 1000.0 * PULSE_KMH_TICKS / PULSE_TICKS_PER_S / PULSE_MAX_KMH))
+#define PULSE_HIST_BINS 8
+
+typedef struct {
+  uint16_t count; // intervals
+  uint32_t min_ticks; // shortest interval, 0 if none
+  float gust; // km/h, fastest window of at least 3 s
+  uint16_t hist[PULSE_HIST_BINS]; // intervals < 64 ticks (> 58 km/h), < 128, .. < 4096, longer
+} PulseStats;
+
+uint16_t pulse_ring[PULSE_RING_LEN];
+
+// 0: TC3 stopped at the overflow, more than 64 s without a pulse
+uint32_t pulse_interval(uint16_t capture){ return capture ? capture : 0x10000;}
+
+uint8_t pulse_hist_bin(uint32_t ticks){
+  uint8_t b = 0;
+  ticks >>= 6;
+  while(ticks && b < PULSE_HIST_BINS - 1){ ticks >>= 1; b++;}
+  return b;
+}
+
+float pulse_speed(uint32_t pulses, uint32_t ticks){ return pulses * PULSE_KMH_TICKS / ticks;}
+
+// the n intervals ring[start], ring[start + 1], .. (wrapping at len), oldest first. The gust window is the shortest run of
+// intervals ending at an interval with at least 3 s, shorter runs (start of the data) are averaged over 3 s.
+void pulse_stats(const uint16_t *ring, uint16_t len, uint16_t start, uint16_t n, PulseStats &s){
+  memset(&s, 0, sizeof(s));
+  s.count = n;
+  uint32_t sum = 0;
+  uint16_t tail = 0; // first interval of the window
+  for(uint16_t i = 0; i < n; i++){
+    uint32_t t = pulse_interval(ring[(start + i) % len]);
+    if(!s.min_ticks || t < s.min_ticks){ s.min_ticks = t;}
+    s.hist[pulse_hist_bin(t)]++;
+    sum += t;
+    while(sum - pulse_interval(ring[(start + tail) % len]) >= PULSE_GUST_TICKS){
+      sum -= pulse_interval(ring[(start + tail) % len]);
+      tail++;
+    }
+    float v = pulse_speed(i - tail + 1, max(sum, (uint32_t)PULSE_GUST_TICKS));
+    if(v > s.gust){ s.gust = v;}
+  }
+}
+
+// after read_pulse_capture(): pos is the next ring index, wrapped if the ring was filled at least once. Without a wrap the
+// first capture is the time from the setup to the first pulse, not an interval.
+void pulse_capture_stats(uint16_t pos, bool wrapped, PulseStats &s){
+  if(wrapped){
+    pulse_stats(pulse_ring, PULSE_RING_LEN, pos, PULSE_RING_LEN, s);
+  } else {
+    pulse_stats(pulse_ring, PULSE_RING_LEN, 1, pos > 1 ? pos - 1 : 0, s);
+  }
+}
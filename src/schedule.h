@@ -0,0 +1,224 @@
+#pragma once
+#include <Arduino.h>
+#include "logging.h"
+
+// Message scheduling: periodic tasks and the time until the next one is due
+
+#define VBATT_LOW 3.35 // Volt
+
+extern uint32_t time();
+
+extern float batt_volt;
+extern bool undervoltage;
+extern bool reduced_interval;
+extern float reduce_interval_voltage;
+
+extern uint32_t broadcast_scale_factor;
+extern uint32_t last_fnet_send;
+extern uint32_t fanet_cooldown;
+
+bool fanet_cooldown_ok();
+
+// Task scheduler ----------------------------------------------------------------------------------------------------------------------
+// Periodic work is registered as tasks in a static min-heap ordered by deadline. loop() runs what is due, the next RTC wake
+// is read from the queue head instead of recomputing every interval.
+
+#define TASK_SCALED 0x01 // period is multiplied with broadcast_scale_factor (battery state)
+#define TASK_RADIO  0x02 // sends a FANET frame, deferred until the fanet cooldown is over
+#define TASK_WAKE   0x04 // may wake the device from sleep, otherwise runs only while awake anyway
+
+#define TASK_IDLE_SLEEP 12000 // ms to sleep if no task needs to wake us
+
+enum TaskId {
+  TASK_WEATHER,
+  TASK_NAME,
+  TASK_INFO,
+  TASK_BARO,
+  TASK_HEATER,
+  TASK_SETTINGS,
+  TASK_COUNT
+};
+
+#define TASK_NOT_QUEUED 0xFF
+
+typedef struct {
+  void (*run)();
+  uint32_t period;   // ms, 0: one shot
+  uint32_t deadline; // time()
+  uint8_t policy;
+  uint8_t heap_pos;
+} Task;
+
+Task tasks[TASK_COUNT];
+uint8_t task_heap[TASK_COUNT]; // task ids, earliest deadline first
+uint8_t task_heap_len = 0;
+
+// deadline of a is before b, also across the time() overflow
+bool task_before(uint8_t a, uint8_t b){
+  return (int32_t)(tasks[a].deadline - tasks[b].deadline) < 0;
+}
+
+void task_heap_set(uint8_t pos, uint8_t id){
+  task_heap[pos] = id;
+  tasks[id].heap_pos = pos;
+}
+
+void task_sift_up(uint8_t pos){
+  uint8_t id = task_heap[pos];
+  while(pos){
+    uint8_t parent = (pos - 1) / 2;
+    if(!task_before(id, task_heap[parent])){ break;}
+    task_heap_set(pos, task_heap[parent]);
+    pos = parent;
+  }
+  task_heap_set(pos, id);
+}
+
+void task_sift_down(uint8_t pos){
+  uint8_t id = task_heap[pos];
+  while(true){
+    uint8_t child = 2 * pos + 1;
+    if(child >= task_heap_len){ break;}
+    if(child + 1 < task_heap_len && task_before(task_heap[child + 1], task_heap[child])){ child++;}
+    if(!task_before(task_heap[child], id)){ break;}
+    task_heap_set(pos, task_heap[child]);
+    pos = child;
+  }
+  task_heap_set(pos, id);
+}
+
+void task_schedule(uint8_t id, uint32_t deadline);
+
+// unregisters all tasks. A queued one shot (end of a baro conversion) stays queued, its run() is kept until it is registered again
+void tasks_init(){
+  uint8_t keep[TASK_COUNT];
+  uint8_t n = 0;
+  for(uint8_t i = 0; i < TASK_COUNT; i++){
+    if(tasks[i].run && !tasks[i].period && tasks[i].heap_pos != TASK_NOT_QUEUED){
+      keep[n++] = i;
+    } else {
+      tasks[i].run = NULL;
+    }
+    tasks[i].heap_pos = TASK_NOT_QUEUED;
+  }
+  task_heap_len = 0;
+  for(uint8_t i = 0; i < n; i++){
+    task_schedule(keep[i], tasks[keep[i]].deadline);
+  }
+}
+
+void task_register(uint8_t id, void (*run)(), uint32_t period, uint8_t policy){
+  tasks[id].run = run;
+  tasks[id].period = period;
+  tasks[id].policy = policy;
+}
+
+// period with battery scaling applied
+uint32_t task_period(uint8_t id){
+  return (tasks[id].policy & TASK_SCALED) ? tasks[id].period * broadcast_scale_factor : tasks[id].period;
+}
+
+// first deadline of a periodic task, one period after its last run (0: never ran) but not in the past
+uint32_t task_first_deadline(uint8_t id, uint32_t last_run){
+  uint32_t now = time();
+  uint32_t deadline = (last_run ? last_run : now) + task_period(id);
+  return (int32_t)(deadline - now) < 0 ? now : deadline;
+}
+
+// queue task or move it to a new deadline
+void task_schedule(uint8_t id, uint32_t deadline){
+  Task &t = tasks[id];
+  if(t.heap_pos == TASK_NOT_QUEUED){
+    t.deadline = deadline;
+    t.heap_pos = task_heap_len++;
+    task_heap[t.heap_pos] = id;
+    task_sift_up(t.heap_pos);
+  } else {
+    bool earlier = (int32_t)(deadline - t.deadline) < 0;
+    t.deadline = deadline;
+    if(earlier){ task_sift_up(t.heap_pos);} else { task_sift_down(t.heap_pos);}
+  }
+}
+
+void task_cancel(uint8_t id){
+  uint8_t pos = tasks[id].heap_pos;
+  if(pos == TASK_NOT_QUEUED){ return;}
+  tasks[id].heap_pos = TASK_NOT_QUEUED;
+  task_heap_len--;
+  if(pos == task_heap_len){ return;}
+  task_heap_set(pos, task_heap[task_heap_len]);
+  task_sift_up(pos);
+  task_sift_down(tasks[task_heap[pos]].heap_pos);
+}
+
+bool task_queued(uint8_t id){
+  return tasks[id].heap_pos != TASK_NOT_QUEUED;
+}
+
+// run all due tasks. Periodic tasks are requeued before they run, so run() may move its own deadline (retry, cancel)
+void tasks_run(){
+  for(uint8_t n = 0; n < TASK_COUNT && task_heap_len; n++){ // every task at most once per call
+    uint8_t id = task_heap[0];
+    Task &t = tasks[id];
+    if((int32_t)(time() - t.deadline) < 0){ break;}
+    if((t.policy & TASK_RADIO) && !fanet_cooldown_ok()){
+      task_schedule(id, last_fnet_send + fanet_cooldown + 1);
+      continue;
+    }
+    if(t.period){ task_schedule(id, time() + task_period(id));} else { task_cancel(id);}
+    t.run();
+  }
+}
+
+// earliest deadline of a task that may wake the device, false if there is none
+bool task_next_wake(uint32_t &deadline){
+  if(task_heap_len && (tasks[task_heap[0]].policy & TASK_WAKE)){ // usual case
+    deadline = tasks[task_heap[0]].deadline;
+    return true;
+  }
+  bool found = false;
+  for(uint8_t i = 1; i < task_heap_len; i++){
+    uint8_t id = task_heap[i];
+    if((tasks[id].policy & TASK_WAKE) && (!found || (int32_t)(tasks[id].deadline - deadline) < 0)){
+      deadline = tasks[id].deadline;
+      found = true;
+    }
+  }
+  return found;
+}
+
+// calc time to sleep til the next task needs to run
+uint32_t calc_time_to_sleep(){
+  uint32_t tts = 0;
+
+  if(batt_volt){
+    if(batt_volt < VBATT_LOW){
+      tts = 3600*500; // sleep 30min
+      undervoltage = true;
+      broadcast_scale_factor = 5;
+      log_i("Undervoltage\n");
+    } else if(batt_volt < reduce_interval_voltage){
+      reduced_interval = true;
+      broadcast_scale_factor = 3;
+      log_i("Low voltage\n");
+    } else {
+      // battery voltage is normal
+      reduced_interval = false;
+      broadcast_scale_factor = 1;
+    }
+
+
+  }
+  if(!undervoltage){
+    uint32_t deadline;
+    if(!task_next_wake(deadline)){
+      return TASK_IDLE_SLEEP;
+    }
+    tts = (int32_t)(deadline - time()) > 0 ? deadline - time() : 0;
+    if( fanet_cooldown && last_fnet_send  && (time() - last_fnet_send + tts < fanet_cooldown)){
+      tts += fanet_cooldown - (time()-last_fnet_send);
+    }
+  }
+
+  return tts;
+}
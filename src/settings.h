@@ -0,0 +1,136 @@
+#pragma once
+#include <Arduino.h>
+#include "energy.h"
+#include "flashrow.h"
+
+// Settings snapshot: the values applied from settings.txt, kept in a flash row together with a key of the file. The FAT
+// is memory mapped, so settings_file_key() hashes the directory entry (name, size, date, first cluster) and the first
+// cluster of settings.txt straight from flash. If the key matches, setup() copies the snapshot instead of mounting the
+// FAT and parsing the file. Any change to the file changes the key, a new firmware erases the slot.
+
+#define SETTINGS_SNAP_MAGIC 0x53544553 // "SETS"
+#define SETTINGS_SNAP_VERSION 3 // count up if SettingsValues changes meaning without changing size
+#define SETTINGS_NAME_LEN 64
+
+typedef struct {
+  char station_name[SETTINGS_NAME_LEN];
+  float pos_lat;
+  float pos_lon;
+  float altitude;
+  float heater_voltage;
+  float mppt_voltage;
+  float reduce_interval_voltage;
+  int32_t heading_offset;
+  int32_t div_cpu_slow;
+  uint32_t gust_age;
+  uint32_t wind_age;
+  uint32_t broadcast_interval_weather;
+  uint32_t broadcast_interval_name;
+  uint32_t broadcast_interval_info;
+  uint32_t sensor_integration_time;
+  uint32_t gps_baud;
+  uint32_t energy_current[ENERGY_PHASES];
+  uint8_t gust_rank;
+  uint8_t gust_percentile;
+  uint8_t wind_mode;
+  bool is_heater;
+  bool is_baro;
+  bool is_davis6410;
+  bool is_wsxx;
+  bool is_ws80;
+  bool is_ws85;
+  bool is_gps;
+  bool debug_enabled;
+  bool errors_enabled;
+  bool no_sleep;
+  bool test_with_usb;
+  bool testmode;
+  bool use_wdt;
+  bool forward_serial_while_usb;
+  bool test_heater;
+  bool skip_lora;
+} SettingsValues;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t layout; // SETTINGS_SNAP_VERSION and sizeof(SettingsValues)
+  uint32_t key; // settings_file_key() of the parsed file
+  SettingsValues v;
+} SettingsSnapshot;
+
+#define SETTINGS_SNAP_LAYOUT ((SETTINGS_SNAP_VERSION << 16) | sizeof(SettingsValues))
+
+FLASH_ROW(settings_snap_row, SettingsSnapshot);
+#ifdef NATIVE
+void settings_snap_write(const SettingsSnapshot &s){ flash_row_write(settings_snap_row, &s, sizeof(s));}
+#else
+FlashStorageClass<SettingsSnapshot> settings_snap_flash(settings_snap_row);
+void settings_snap_write(const SettingsSnapshot &s){ settings_snap_flash.write(s);}
+#endif
+
+void settings_snap_read(SettingsSnapshot &s){ flash_row_read(settings_snap_row, &s, sizeof(s));}
+
+// FNV-1a
+uint32_t fnv1a(const uint8_t *data, uint32_t len, uint32_t h = 2166136261UL){
+  while(len--){ h = (h ^ *data++) * 16777619UL;}
+  return h;
+}
+
+uint16_t rd16(const uint8_t *p){ return p[0] | (p[1] << 8);}
+uint32_t rd32(const uint8_t *p){ return rd16(p) | ((uint32_t)rd16(p + 2) << 16);}
+
+// Key of a file in the root directory of a FAT12/16 volume image (with or without partition table), name in 8.3 directory
+// form ("SETTINGSTXT"). 0 if there is no such file or the image doesn't look like FAT.
+uint32_t settings_file_key(const uint8_t *vol, uint32_t size, const char *name83){
+  if(size < 512){ return 0;}
+  const uint8_t *bs = vol;
+  if(bs[0] != 0xEB && bs[0] != 0xE9){ // no boot sector, first partition of the MBR
+    if(bs[510] != 0x55 || bs[511] != 0xAA){ return 0;}
+    uint32_t lba = rd32(bs + 446 + 8);
+    if(lba >= size/512){ return 0;}
+    bs = vol + lba*512;
+  }
+  const uint8_t *end = vol + size;
+  if(bs + 512 > end){ return 0;}
+  uint16_t sector_size = rd16(bs + 11);
+  uint8_t cluster_sectors = bs[13];
+  uint32_t root = rd16(bs + 14) + bs[16]*rd16(bs + 22); // reserved + FATs
+  uint16_t root_entries = rd16(bs + 17);
+  if(sector_size != 512 || !cluster_sectors || !root_entries){ return 0;} // FAT32 has no fixed root directory
+  uint32_t data = root + (root_entries*32 + 511)/512;
+
+  for(uint16_t i = 0; i < root_entries; i++){
+    const uint8_t *e = bs + root*512 + i*32;
+    if(e + 32 > end || e[0] == 0){ return 0;} // end of directory
+    if(e[0] == 0xE5 || (e[11] & 0x0F) == 0x0F || (e[11] & 0x18)){ continue;} // deleted, long name, volume label or directory
+    if(memcmp(e, name83, 11)){ continue;}
+    uint32_t h = fnv1a(e, 32);
+    uint16_t cluster = rd16(e + 26);
+    const uint8_t *c = bs + (data + (cluster - 2)*cluster_sectors)*512;
+    if(cluster >= 2 && c + cluster_sectors*512 <= end){ h = fnv1a(c, cluster_sectors*512, h);}
+    return h ? h : 1;
+  }
+  return 0;
+}
+
+// true and v filled if the stored snapshot belongs to key
+bool settings_snapshot_load(uint32_t key, SettingsValues &v){
+  SettingsSnapshot s;
+  settings_snap_read(s);
+  if(!key || s.magic != SETTINGS_SNAP_MAGIC || s.layout != SETTINGS_SNAP_LAYOUT || s.key != key){ return false;}
+  memcpy(&v, &s.v, sizeof(v));
+  return true;
+}
+
+// writes the row only if something changed
+void settings_snapshot_save(uint32_t key, const SettingsValues &v){
+  SettingsSnapshot s;
+  settings_snap_read(s);
+  if(s.magic == SETTINGS_SNAP_MAGIC && s.layout == SETTINGS_SNAP_LAYOUT && s.key == key && !memcmp(&s.v, &v, sizeof(v))){ return;}
+  SettingsSnapshot n;
+  n.magic = SETTINGS_SNAP_MAGIC;
+  n.layout = SETTINGS_SNAP_LAYOUT;
+  n.key = key;
+  n.v = v;
+  settings_snap_write(n);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+
+// Wake cycle trace: compact binary records in a RAM ring, dumped over USB with TRACE=1 and rendered per wake by
+// tools/trace_decode.py. An event costs a few stores instead of a log_i(), so it doesn't distort the timing it records.
+
+#define TRACE_LEN 128 // records, power of 2
+#define TRACE_VERSION 1
+#define TRACE_SATURATED 0x01 // flag: dt or arg did not fit in 16 bit
+
+extern uint32_t time();
+extern bool usb_connected;
+
+enum TraceEvent {
+  TRACE_NONE,
+  TRACE_SLEEP_ENTER, // go_sleep() entry, arg: time to sleep (ms)
+  TRACE_SLEEP_EXIT,  // go_sleep() exit, arg: wakeup source
+  TRACE_WAKEUP,      // wakeup() done
+  TRACE_BARO_START,  // baro_start_reading(), arg: conversion time (ms)
+  TRACE_PARSE_DONE,  // WSXX block complete, arg: bytes received
+  TRACE_TX_START,    // startTransmit(), arg: frame length
+  TRACE_TX_DONE,     // transmittedFlag seen, arg: time on air incl. latency (ms)
+  TRACE_TX_TIMEOUT   // send timed out, arg: ms since start
+};
+
+typedef struct {
+  uint8_t event;
+  uint8_t flags;
+  uint16_t dt;  // ms since previous record
+  uint16_t arg;
+} TraceRecord;
+
+TraceRecord trace_ring[TRACE_LEN];
+uint16_t trace_head = 0; // next record to write
+uint16_t trace_count = 0;
+uint32_t trace_last = 0; // time() of the previous record
+
+void trace(uint8_t event, uint32_t arg = 0){
+  uint32_t now = time();
+  uint32_t dt = now - trace_last;
+  trace_last = now;
+  TraceRecord &r = trace_ring[trace_head];
+  r.event = event;
+  r.flags = (dt > 0xFFFF || arg > 0xFFFF) ? TRACE_SATURATED : 0;
+  r.dt = dt > 0xFFFF ? 0xFFFF : dt;
+  r.arg = arg > 0xFFFF ? 0xFFFF : arg;
+  trace_head = (trace_head + 1) & (TRACE_LEN - 1);
+  if(trace_count < TRACE_LEN){ trace_count++;}
+}
+
+void trace_clear(){
+  trace_head = 0;
+  trace_count = 0;
+}
+
+// binary dump over USB CDC: "BDTR", version, record size, count (u16), time() (u32), then the records oldest first, little endian
+void trace_dump(){
+  if(!usb_connected){ return;}
+  uint32_t now = time();
+  uint8_t header[12] = {'B', 'D', 'T', 'R', TRACE_VERSION, sizeof(TraceRecord),
+                        (uint8_t)trace_count, (uint8_t)(trace_count >> 8),
+                        (uint8_t)now, (uint8_t)(now >> 8), (uint8_t)(now >> 16), (uint8_t)(now >> 24)};
+  Serial.write(header, sizeof(header));
+  uint16_t p = (trace_head - trace_count) & (TRACE_LEN - 1);
+  for(uint16_t i = 0; i < trace_count; i++){
+    Serial.write((const uint8_t*)&trace_ring[p], sizeof(TraceRecord));
+    p = (p + 1) & (TRACE_LEN - 1);
+  }
+  Serial.flush();
+}
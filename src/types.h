@@ -25,6 +25,26 @@
     float Charge; //+1byte lower 4 bits: 0x00 = 0%, 0x01 = 6.666%, .. 0x0F = 100%
   } weatherData;
 
+  // Weather data as scaled integers from the measurement layer, encoded by pack_weatherdata_fixed() without float math
+  typedef struct {
+    uint16_t vid;
+    uint16_t fanet_id;
+    int32_t lat_i; // latitude, see fanet_encode_lat()
+    int32_t lon_i; // longitude, see fanet_encode_lon()
+    bool bTemp;
+    int16_t temp10; // 0.1 °C
+    bool bWind;
+    uint16_t heading; // 0..359 °
+    uint16_t speed10; // 0.1 km/h
+    uint16_t gust10; // 0.1 km/h
+    bool bHumidity;
+    uint8_t humidity; // 0..100 %
+    bool bBaro;
+    int16_t baro10; // 0.1 hPa
+    bool bStateOfCharge;
+    int16_t charge; // %
+  } weatherDataFixed;
+
   typedef struct {
     
     unsigned int type           :6;
@@ -64,6 +84,10 @@
   } __attribute__((packed)) fanet_packet_t4;
 
 
+  // position in FANET units, only needs to be calculated when the position changes
+  int32_t fanet_encode_lat(float lat){ return roundf(lat * 93206.0f);}
+  int32_t fanet_encode_lon(float lon){ return roundf(lon * 46603.0f);}
+
   void pack_weatherdata(weatherData *wData, uint8_t * buffer){
 
   fanet_packet_t4 *pkt = (fanet_packet_t4 *)buffer;
@@ -81,11 +105,8 @@
   pkt->bTemp = wData->bTemp;
   pkt->bInternetGateway = false;
 
-  int32_t lat_i = roundf(wData->lat * 93206.0f);
-	int32_t lon_i = roundf(wData->lon * 46603.0f);
-
-  pkt->latitude = lat_i;
-  pkt->longitude = lon_i;
+  pkt->latitude = fanet_encode_lat(wData->lat);
+  pkt->longitude = fanet_encode_lon(wData->lon);
 
   if (wData->bTemp){
     int iTemp = (int)(round(wData->temp * 2)); //Temperature (+1byte in 0.5 degree, 2-Complement)
@@ -117,4 +138,69 @@
     pkt->baro = int16_t(round((wData->Baro - 430.0) * 10));  //Barometric pressure normailized (+2byte: in 10Pa, offset by 430hPa, unsigned little endian (hPa-430)*10)
   }
   pkt->charge = constrain(roundf(float(wData->Charge) / 100.0 * 15.0),0,15); //State of Charge  (+1byte lower 4 bits: 0x00 = 0%, 0x01 = 6.666%, .. 0x0F = 100%)
+}
+
+  // Constant part of a type 4 frame: header and position. Only needs to be rebuilt when one of them changes
+  void pack_weatherdata_header(fanet_packet_t4 *pkt, uint16_t vid, uint16_t fanet_id, int32_t lat_i, int32_t lon_i){
+  pkt->header.type = 4;
+  pkt->header.vendor = vid;
+  pkt->header.forward = false;
+  pkt->header.ext_header = false;
+  pkt->header.address = fanet_id;
+  pkt->bExt_header2 = false;
+  pkt->bRemoteConfig = false;
+  pkt->bInternetGateway = false;
+  pkt->latitude = lat_i;
+  pkt->longitude = lon_i;
+}
+
+  // Dynamic part of a type 4 frame from integer inputs, the rounding below reproduces roundf()/round() of pack_weatherdata()
+  void pack_weatherdata_values(weatherDataFixed *wData, uint8_t * buffer){
+
+  fanet_packet_t4 *pkt = (fanet_packet_t4 *)buffer;
+  pkt->bStateOfCharge = wData->bStateOfCharge;
+  pkt->bBaro = wData->bBaro;
+  pkt->bHumidity = wData->bHumidity;
+  pkt->bWind = wData->bWind;
+  pkt->bTemp = wData->bTemp;
+
+  if (wData->bTemp){
+    int t = wData->temp10; // 0.5 degree steps, rounded half away from zero
+    int iTemp = t >= 0 ? (t + 2) / 5 : -((2 - t) / 5);
+    pkt->temp = iTemp & 0xFF;
+  }
+  if (wData->bWind){
+    pkt->heading = uint8_t((wData->heading * 256 + 180) / 360);
+    int speed = (wData->speed10 + 1) / 2; // 0.2 km/h steps
+    if(speed > 127) {
+        pkt->speed_scale  = 1;
+        pkt->speed        = (speed / 5);
+    } else {
+        pkt->speed_scale  = 0;
+        pkt->speed        = speed & 0x7F;
+    }
+    speed = (wData->gust10 + 1) / 2;
+    if(speed > 127) {
+        pkt->gust_scale  = 1;
+        pkt->gust        = (speed / 5);
+    } else {
+        pkt->gust_scale  = 0;
+        pkt->gust        = speed & 0x7F;
+    }
+  }
+  if (wData->bHumidity){
+      pkt->humidity = uint8_t((wData->humidity * 5 + 1) / 2); // 0.4% steps
+  }
+  if (wData->bHumidity){ // baro is only written with humidity, like pack_weatherdata()
+    pkt->baro = int16_t(wData->baro10 - 4300);
+  }
+  int charge = wData->charge * 30 + 100; // 1/15 steps
+  pkt->charge = charge < 0 ? 0 : min(charge / 200, 15);
+}
+
+  // Same frame as pack_weatherdata() without float math, the values come scaled from the sensors (temperature10,
+  // baro_pressure10, wind slots in 0.1 km/h)
+  void pack_weatherdata_fixed(weatherDataFixed *wData, uint8_t * buffer){
+  pack_weatherdata_header((fanet_packet_t4 *)buffer, wData->vid, wData->fanet_id, wData->lat_i, wData->lon_i);
+  pack_weatherdata_values(wData, buffer);
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+#include "hist.h"
+#include "histlog.h"
+
+// Warm restart: wind_history[] and history[] are NOINIT, a software or watchdog reset leaves them in RAM. warm_seal()
+// copies the scalars that go with them (time base, broadcast timestamps, ring positions) into the NOINIT warm state and
+// stores a CRC over all of it, before every sleep, before reboot() and at the end of every loop() that changed the history
+// (hist_dirty), so a watchdog reset finds the last reading sealed. setup() takes everything over if the reset was not a
+// power on / brown out and magic and CRC match, otherwise it starts clean. A reset between a history write and the next
+// seal fails the CRC and starts clean too. The time from the seal to the reset is not accounted.
+
+#define WARM_MAGIC 0x52574442 // "BDWR"
+
+extern uint32_t sleeptime_cum, sleep_offset, boot_time;
+extern uint32_t last_msg_weather, last_msg_name, last_msg_info, last_fnet_send;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t crc; // over time .. histlog_pending, wind_history[] and history[]
+  uint32_t time; // time() at the seal, continues from here
+  uint32_t last_msg_weather;
+  uint32_t last_msg_name;
+  uint32_t last_msg_info;
+  uint32_t last_fnet_send;
+  uint32_t last_history;
+  int32_t hist_count;
+  uint32_t wind_hist_pos;
+  uint32_t histlog_pending;
+} WarmState;
+
+NOINIT WarmState warm;
+
+// CRC-32 (reflected 0xEDB88320, no final xor) over a word aligned range, the DSU computes it in hardware
+uint32_t warm_crc32(const void *data, uint32_t len, uint32_t crc){
+#ifdef NATIVE
+  const uint8_t *p = (const uint8_t*)data;
+  while(len--){
+    crc ^= *p++;
+    for(uint8_t i = 0; i < 8; i++){ crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));}
+  }
+  return crc;
+#else
+  PAC1->WPCLR.reg = 0x02; // DSU write protection
+  DSU->DATA.reg = crc;
+  DSU->ADDR.reg = (uint32_t)data;
+  DSU->LENGTH.reg = len;
+  DSU->STATUSA.reg = DSU_STATUSA_DONE | DSU_STATUSA_BERR;
+  DSU->CTRL.reg = DSU_CTRL_CRC;
+  while(!DSU->STATUSA.bit.DONE){}
+  if(DSU->STATUSA.bit.BERR){ return ~crc;} // bus error, the result won't match
+  return DSU->DATA.reg;
+#endif
+}
+
+uint32_t warm_state_crc(){
+  uint32_t crc = 0xFFFFFFFF;
+  crc = warm_crc32(&warm.time, sizeof(warm) - offsetof(WarmState, time), crc);
+  crc = warm_crc32(wind_history, sizeof(wind_history), crc);
+  crc = warm_crc32(history, sizeof(history), crc);
+  return crc;
+}
+
+void warm_seal(){
+  warm.time = time();
+  warm.last_msg_weather = last_msg_weather;
+  warm.last_msg_name = last_msg_name;
+  warm.last_msg_info = last_msg_info;
+  warm.last_fnet_send = last_fnet_send;
+  warm.last_history = last_history;
+  warm.hist_count = hist_count;
+  warm.wind_hist_pos = wind_hist_pos;
+  warm.histlog_pending = histlog_pending;
+  warm.crc = warm_state_crc();
+  warm.magic = WARM_MAGIC;
+  hist_dirty = false;
+}
+
+bool warm_power_on(){
+#ifdef NATIVE
+  return false;
+#else
+  return PM->RCAUSE.reg & (PM_RCAUSE_POR | PM_RCAUSE_BOD12 | PM_RCAUSE_BOD33);
+#endif
+}
+
+// setup(): true if the sealed state was taken over, false on a cold start
+bool warm_restore(){
+  bool ok = !warm_power_on() && warm.magic == WARM_MAGIC && warm.crc == warm_state_crc();
+  warm.magic = 0;
+  if(!ok){ return false;}
+  last_msg_weather = warm.last_msg_weather;
+  last_msg_name = warm.last_msg_name;
+  last_msg_info = warm.last_msg_info;
+  last_fnet_send = warm.last_fnet_send;
+  last_history = warm.last_history;
+  hist_count = warm.hist_count;
+  wind_hist_pos = warm.wind_hist_pos;
+  histlog_pending = warm.histlog_pending;
+  sleep_offset = 0;
+  sleeptime_cum = warm.time - millis();
+  boot_time = sleeptime_cum; // uptime() still counts from this reset
+  return true;
+}
+
+#ifndef NATIVE
+// software reset that keeps the buffers
+void reboot(){
+  warm_seal();
+  NVIC_SystemReset();
+}
+#endif
@@ -0,0 +1,392 @@
+#pragma once
+#include <Arduino.h>
+#include "logging.h"
+#include "hist.h"
+#include "trace.h"
+
+// Ecowitt WS80/WS85 UART: read a block and parse 'key = value' lines into the measurement globals
+
+#define WSXX_UART Serial1
+
+extern uint32_t time();
+
+extern int wind_dir_raw;
+extern float wind_speed;
+extern float wind_gust;
+extern float temperature;
+extern int humidity;
+extern int light_lux;
+extern float uv_level;
+extern float wsxx_vcc;
+extern float cap_voltage;
+extern bool is_ws80;
+extern bool is_ws85;
+extern bool test_with_usb;
+extern uint32_t last_wsxx_data;
+
+enum ResParseChar {
+  RESP_OK,
+  RESP_ERROR,
+  RESP_COMPLETE
+};
+
+// process line in 'key=value' format and hand to callback function
+bool process_line(char * in, int len, bool (*cb)(char*, char*)){
+  #define BUFFLEN 127
+  char name [BUFFLEN];
+  char value [BUFFLEN];
+  memset(name,'\0',BUFFLEN);
+  memset(value,'\0',BUFFLEN);
+  bool literal = false; // 
+  char* ptr = name; //start with name filed
+  int c = 0; // counter
+  int oc= 0; // output counter
+  bool cont = true; //continue flag
+
+  while (cont && (c < max(len,BUFFLEN)) && (oc < (BUFFLEN-1))){ // limit to 255 chars per line
+    if(in[c] < 127){
+      switch (in[c]) {
+        case '\r': if(c != 0) {cont = false;} break;
+        case '\n': cont = false; break;
+        //case '-': cont = false; break; // catches negative temps
+        case '>': cont = false; break;
+        case '!':  cont = false; break;
+        case '#':  cont = false; break;
+        case '?':  literal = true; break; // enable literal mode
+        case '=':  if(oc && (ptr == name) ){ *(ptr+oc) = '\0'; ptr = value; oc = 0;} break; // switch to value
+        case ' ':  if(!literal) {break;} // avoid removing whitespaces from name
+                   // fall through
+        default:   *(ptr+oc) = in[c]; oc++; break; // copy char
+      }
+    }
+    c++;
+  }
+  if(oc && (ptr == value)){ // value is set
+    return cb(name, value);
+  }
+  
+  return false;
+}
+
+
+// Streaming parser ----------------------------------------------------------------------------------------------------------------------
+// Consumes the sensor output byte by byte as it arrives, no line buffer. Follows the rules of process_line(): spaces are
+// dropped, '>' '!' '#' end a line, only the first '=' separates key and value. Values are decoded like atof() into 1/1000
+// units while they stream in and applied at the end of the line, BatVoltage completes the block.
+
+#define WSXX_KEY_MAX 15 // longest key we need is 11 chars, longer keys can't match
+
+enum WsxxState {
+  WSXX_STATE_KEY,
+  WSXX_STATE_VALUE,
+  WSXX_STATE_SKIP // rest of line is ignored
+};
+
+enum WsxxKey {
+  WSXX_NONE,
+  WSXX_WINDDIR,
+  WSXX_WINDSPEED,
+  WSXX_WINDGUST,
+  WSXX_TEMPERATURE,
+  WSXX_GXTS04TEMP,
+  WSXX_HUMI,
+  WSXX_LIGHT,
+  WSXX_UV_VALUE,
+  WSXX_CAPVOLTAGE,
+  WSXX_BATVOLTAGE
+};
+
+constexpr const char* wsxx_keys[] = {"", "WindDir", "WindSpeed", "WindGust", "Temperature", "GXTS04Temp", "Humi", "Light", "UV_Value", "CapVoltage", "BatVoltage"};
+#define WSXX_KEY_COUNT (sizeof(wsxx_keys)/sizeof(wsxx_keys[0]))
+
+// Key hash ------------------------------------------------------------------------------------------------------------------------------
+// FNV-1a over the key chars as they stream in, the top bits pick a slot. The seed is searched at compile time until all known keys
+// land in different slots, so a line costs one table read and one compare. Written as C++11 constexpr for the Arduino core.
+
+#define WSXX_HASH_BITS 5
+
+constexpr uint32_t wsxx_hash_step(uint32_t h, char c){ return (h ^ (uint8_t)c) * 16777619u;}
+constexpr uint32_t wsxx_hash_str(const char* s, uint32_t h){ return *s ? wsxx_hash_str(s + 1, wsxx_hash_step(h, *s)) : h;}
+constexpr uint8_t wsxx_hash_slot(uint32_t h){ return h >> (32 - WSXX_HASH_BITS);}
+constexpr uint8_t wsxx_key_slot(uint32_t seed, uint8_t i){ return wsxx_hash_slot(wsxx_hash_str(wsxx_keys[i], seed));}
+
+constexpr bool wsxx_slot_unique(uint32_t seed, uint8_t i, uint8_t j){
+  return j >= WSXX_KEY_COUNT || (wsxx_key_slot(seed, i) != wsxx_key_slot(seed, j) && wsxx_slot_unique(seed, i, j + 1));
+}
+constexpr bool wsxx_seed_perfect(uint32_t seed, uint8_t i = 1){
+  return i >= WSXX_KEY_COUNT || (wsxx_slot_unique(seed, i, i + 1) && wsxx_seed_perfect(seed, i + 1));
+}
+constexpr uint32_t wsxx_find_seed(uint32_t seed){ return wsxx_seed_perfect(seed) ? seed : wsxx_find_seed(seed + 1);}
+
+constexpr uint32_t WSXX_HASH_SEED = wsxx_find_seed(2166136261u); // FNV offset basis as start
+static_assert(WSXX_KEY_COUNT - 1 <= (1 << WSXX_HASH_BITS), "more WSXX keys than hash slots");
+static_assert(wsxx_seed_perfect(WSXX_HASH_SEED), "WSXX key hash is not collision free");
+
+constexpr uint8_t wsxx_slot_key(uint8_t slot, uint8_t i = 1){
+  return i >= WSXX_KEY_COUNT ? 0 : (wsxx_key_slot(WSXX_HASH_SEED, i) == slot ? i : wsxx_slot_key(slot, i + 1));
+}
+
+#define WSXX_SLOTS4(s) wsxx_slot_key(s), wsxx_slot_key(s + 1), wsxx_slot_key(s + 2), wsxx_slot_key(s + 3)
+const uint8_t wsxx_hash_table[1 << WSXX_HASH_BITS] = { // slot -> WsxxKey
+  WSXX_SLOTS4(0), WSXX_SLOTS4(4), WSXX_SLOTS4(8), WSXX_SLOTS4(12), WSXX_SLOTS4(16), WSXX_SLOTS4(20), WSXX_SLOTS4(24), WSXX_SLOTS4(28)
+};
+static_assert(sizeof(wsxx_hash_table) == 32, "wsxx_hash_table is filled for WSXX_HASH_BITS 5");
+
+typedef struct {
+  uint8_t state;
+  uint8_t key_id;
+  bool literal;       // '?' keeps spaces
+  char key[WSXX_KEY_MAX];
+  uint8_t key_len;
+  bool has_value;     // value is not empty
+  int32_t value;      // 1/1000
+  bool neg;
+  uint8_t num_state;  // see wsxx_value_char()
+  uint8_t eq_count;   // consecutive '=', a block ends with 37
+  uint8_t comp1_pos;
+  uint8_t comp2_pos;
+  bool found_data;    // block header seen
+} WsxxParser;
+
+WsxxParser wsxx;
+uint32_t wsxx_serial_wait = 3800; // us without new data until read_wsxx() gives up
+int16_t temperature10 = 0; // 0.1 °C, from the sensor without float conversion
+
+void wsxx_reset_line(){
+  wsxx.state = WSXX_STATE_KEY;
+  wsxx.key_id = WSXX_NONE;
+  wsxx.literal = false;
+  wsxx.key_len = 0;
+  wsxx.has_value = false;
+  wsxx.value = 0;
+  wsxx.neg = false;
+  wsxx.num_state = 0;
+}
+
+// hash of the buffered key, one slot read and one compare, unknown keys mostly hit an empty slot
+uint8_t wsxx_lookup_key(){
+  uint32_t h = WSXX_HASH_SEED;
+  for(uint8_t i = 0; i < wsxx.key_len; i++){ h = wsxx_hash_step(h, wsxx.key[i]);}
+  uint8_t id = wsxx_hash_table[wsxx_hash_slot(h)];
+  if(id && strlen(wsxx_keys[id]) == wsxx.key_len && memcmp(wsxx.key, wsxx_keys[id], wsxx.key_len) == 0){ return id;}
+  return WSXX_NONE;
+}
+
+// atof() like decoding, stops at the first char that doesn't belong to the number
+// num_state 0: start, sign allowed, 1: integer digits, 2..4: next is 1st..3rd decimal, 5: further decimals ignored, 6: ended
+void wsxx_value_char(char c){
+  static const int16_t decimal_scale[] = {100, 10, 1};
+  uint8_t d = c - '0';
+  bool digit = d < 10;
+  wsxx.has_value = true;
+  if(digit && wsxx.num_state == 1){ // integer digits, the common case
+    if(wsxx.value < 200000000){ wsxx.value = wsxx.value * 10 + d * 1000;}
+    return;
+  }
+  if(wsxx.num_state == 6){ return;}
+
+  if(wsxx.num_state == 0 && (c == '-' || c == '+')){
+    wsxx.neg = (c == '-');
+    wsxx.num_state = 1;
+  } else if(digit && wsxx.num_state < 2){
+    if(wsxx.value < 200000000){ wsxx.value = wsxx.value * 10 + (c - '0') * 1000;}
+    wsxx.num_state = 1;
+  } else if(digit && wsxx.num_state < 5){
+    wsxx.value += (c - '0') * decimal_scale[wsxx.num_state - 2];
+    wsxx.num_state++;
+  } else if(digit && wsxx.num_state == 5){
+    // more than 3 decimals
+  } else if(c == '.' && wsxx.num_state < 2){
+    wsxx.num_state = 2;
+  } else {
+    wsxx.num_state = 6;
+  }
+}
+
+// apply value of a complete line, returns true on BatVoltage
+bool wsxx_apply(){
+  int32_t v = wsxx.neg ? -wsxx.value : wsxx.value;
+  int32_t w = constrain(v, -1000000, 1000000); // m/s, keep *36 within int32
+  switch(wsxx.key_id){
+    case WSXX_WINDDIR: wind_dir_raw = v / 1000; add_wind_history_dir(wind_dir_raw); break;
+    case WSXX_WINDSPEED: wind_speed = w * 0.0036f; add_wind_history_wind10(w > 0 ? w * 36 / 1000 : 0); if(debug_enabled){printf("WindSpeed = %0.2f\n", wind_speed);} break;
+    case WSXX_WINDGUST: wind_gust = w * 0.0036f; add_wind_history_gust10(abs(w) * 36 / 1000); if(debug_enabled){printf("WindGust = %0.2f\n", wind_gust);} break;
+    case WSXX_TEMPERATURE: temperature10 = v / 100; temperature = v * 0.001f; if(!is_ws80){is_ws80=true; is_ws85=false; log_i("Detected WS80\n");} break; // WS80 only - autodetection
+    case WSXX_GXTS04TEMP: temperature10 = v / 100; temperature = v * 0.001f; if(!is_ws85){is_ws85=true; is_ws80=false; log_i("Detected WS85\n");} break; // WS85 only
+    case WSXX_HUMI: humidity = v / 1000; break;
+    case WSXX_LIGHT: light_lux = v / 1000; break;
+    case WSXX_UV_VALUE: uv_level = v * 0.001f; break;
+    case WSXX_CAPVOLTAGE: cap_voltage = v * 0.001f; break; // WS85
+    case WSXX_BATVOLTAGE:
+      wsxx_vcc = v * 0.001f;
+      last_wsxx_data = time();
+      log_i("WSXX data complete\r\n");
+      return true;
+  }
+  return false;
+}
+
+// line is done, apply value if it belongs to a block
+bool wsxx_end_line(){
+  bool complete = false;
+  if(wsxx.state == WSXX_STATE_VALUE && wsxx.has_value && wsxx.found_data){
+    complete = wsxx_apply();
+  }
+  wsxx_reset_line();
+  return complete;
+}
+
+// key chars are only buffered, hashed once at the '='
+void wsxx_key_char(char c){
+  if(wsxx.key_len < WSXX_KEY_MAX){ wsxx.key[wsxx.key_len] = c;}
+  if(wsxx.key_len <= WSXX_KEY_MAX){ wsxx.key_len++;}
+}
+
+// key/value chars of a line
+void wsxx_parse_line_char(char c){
+  if(c == '?'){ wsxx.literal = true; return;} // enable literal mode
+  if(c == ' ' && !wsxx.literal){ return;}
+
+  if(wsxx.state == WSXX_STATE_KEY){
+    if(c == '='){
+      if(wsxx.key_len){
+        wsxx.key_id = wsxx.key_len <= WSXX_KEY_MAX ? wsxx_lookup_key() : (uint8_t)WSXX_NONE;
+        wsxx.state = wsxx.key_id ? WSXX_STATE_VALUE : WSXX_STATE_SKIP; // unknown key, value is not decoded
+      }
+    } else {
+      wsxx_key_char(c);
+    }
+  } else if(c != '='){ // further '=' in the value are dropped
+    wsxx_value_char(c);
+  }
+}
+
+// chars below 64 that wsxx_parse_char() can't pass on to the key or value directly
+#define WSXX_SPECIAL_CHARS ((1ULL << '\r') | (1ULL << '\n') | (1ULL << ' ') | (1ULL << '!') | (1ULL << '#') | (1ULL << '=') | (1ULL << '>') | (1ULL << '?'))
+
+// feed one byte from the sensor, returns RESP_COMPLETE when the block is complete
+int wsxx_parse_char(char c){
+  uint8_t u = c;
+  if(wsxx.found_data && (u < 64 ? !((WSXX_SPECIAL_CHARS >> u) & 1) : u < 127)){ // most of a block, no line end, '=' or block detection
+    wsxx.eq_count = 0;
+    if(wsxx.state == WSXX_STATE_KEY){ wsxx_key_char(c);}
+    else if(wsxx.state == WSXX_STATE_VALUE){ wsxx_value_char(c);}
+    return RESP_OK;
+  }
+  if(u >= 127){ return RESP_OK;} // skip garbage
+  if(u == ' ' && !wsxx.literal && wsxx.found_data){ wsxx.eq_count = 0; return RESP_OK;} // padding between key and '='
+
+  // block detection: header contains FreqSel or the sensor name, block ends with 37x =
+  if(c == '=') {wsxx.eq_count++;} else {wsxx.eq_count = 0;}
+  if(!wsxx.found_data){
+    const char* comp1 = "FreqSel";
+    const char* comp2 = is_ws85 ? "WS85" : (is_ws80 ? "WH80" : "");
+    if(c == comp1[wsxx.comp1_pos]) {wsxx.comp1_pos++;} else {wsxx.comp1_pos = 0;}
+    if(comp2[0] && c == comp2[wsxx.comp2_pos]) {wsxx.comp2_pos++;} else {wsxx.comp2_pos = 0;}
+    if(!comp1[wsxx.comp1_pos] || (comp2[0] && !comp2[wsxx.comp2_pos])){ // if we found or pattern, increase wait time to get full block
+      wsxx.found_data = true;
+      wsxx.comp1_pos = 0;
+      wsxx.comp2_pos = 0;
+      if(is_ws80){ wsxx_serial_wait = 500;}
+      else if(is_ws85){ wsxx_serial_wait = 3800;}
+    }
+  } else if(wsxx.eq_count > 35) { // end of block without BatVoltage, lower wait time
+    wsxx.found_data = false;
+    wsxx_serial_wait = 1;
+  }
+
+  bool complete = false;
+  switch(c){
+    case '\r':
+    case '\n':
+      complete = wsxx_end_line();
+      break;
+    case '>':
+    case '!':
+    case '#':
+      if(wsxx.state != WSXX_STATE_SKIP){
+        complete = wsxx_end_line();
+        wsxx.state = WSXX_STATE_SKIP;
+      }
+      break;
+    default:
+      if(wsxx.state != WSXX_STATE_SKIP){ wsxx_parse_line_char(c);}
+  }
+  if(complete){
+    wsxx.found_data = false;
+    return RESP_COMPLETE;
+  }
+  return RESP_OK;
+}
+
+// read UART and feed the parser, needs to be called periodically until new block is complete (last_wsxx_data = time())
+// returns as soon as BatVoltage has been received, without waiting for the rest of the block
+// 2: data complete
+// 0: data ok, continue
+int read_wsxx(){
+  uint32_t last_data = micros();
+
+  while(micros()- last_data < wsxx_serial_wait){
+    while (WSXX_UART.available()){
+      char c = WSXX_UART.read();
+      if(test_with_usb && usb_connected){
+        Serial.write(c);
+      }
+      last_data = micros();
+      if(wsxx_parse_char(c) == RESP_COMPLETE){
+        wsxx_serial_wait = 120; // decrease value if one valid measuremnt was fount to dertimne if it is ws80 or ws85
+        trace(TRACE_PARSE_DONE);
+        return RESP_COMPLETE;
+      }
+    }
+  }
+  return RESP_OK;
+}
+
+#ifndef NATIVE
+#include "dma.h"
+#include "sleep.h"
+
+#define WSXX_DMA_BUFFERSIZE 1024 // a block is ~600 bytes, extended WS80 output is cut at BatVoltage
+uint8_t wsxx_dma_buffer[WSXX_DMA_BUFFERSIZE];
+
+// like read_wsxx(), but the bytes land in wsxx_dma_buffer by DMA while the CPU idles, it wakes on every SysTick to parse what arrived.
+// Ends at BatVoltage, when the buffer is full or the line is idle for wsxx_serial_wait (at least one tick).
+// 2: data complete
+// 1: error
+// 0: data ok, continue
+int read_wsxx_dma(){
+  uint16_t parsed = 0;
+  uint32_t last_data = micros();
+  int res = RESP_OK;
+
+  dma_uart_rx_start(wsxx_dma_buffer, WSXX_DMA_BUFFERSIZE);
+  while(res == RESP_OK && WSXX_UART.available()){ // bytes received by the Uart ISR before the DMA took over come first
+    if(wsxx_parse_char(WSXX_UART.read()) == RESP_COMPLETE){
+      wsxx_serial_wait = 120;
+      res = RESP_COMPLETE;
+    }
+  }
+  while(res == RESP_OK && micros()- last_data < wsxx_serial_wait){
+    idlesleep();
+    uint16_t received = dma_uart_rx_count();
+    if(received != parsed){
+      last_data = micros();
+    }
+    while(parsed < received){
+      if(wsxx_parse_char(wsxx_dma_buffer[parsed++]) == RESP_COMPLETE){
+        wsxx_serial_wait = 120; // decrease value if one valid measuremnt was fount to dertimne if it is ws80 or ws85
+        res = RESP_COMPLETE;
+        break;
+      }
+    }
+    if(res == RESP_OK && received >= WSXX_DMA_BUFFERSIZE){
+      log_e("Buffer size exeeded\r\n");
+      res = RESP_ERROR;
+    }
+  }
+  dma_uart_rx_stop();
+  if(res == RESP_COMPLETE){ trace(TRACE_PARSE_DONE, parsed);}
+  return res;
+}
+#endif
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+# Decode the wake cycle trace of src/trace.h and print one timeline per wake.
+#
+#   python tools/trace_decode.py COM38           # request the dump with TRACE=1 over USB CDC
+#   python tools/trace_decode.py trace.bin       # decode a saved dump
+#   python tools/trace_decode.py COM38 -o trace.bin --slow 100
+import sys
+import struct
+import argparse
+import os.path
+from time import sleep, time
+
+MAGIC = b"BDTR"
+HEADER = struct.Struct("<4sBBHI")  # magic, version, record size, count, time()
+RECORD = struct.Struct("<BBHH")    # event, flags, dt, arg
+SATURATED = 0x01
+
+# keep in sync with enum TraceEvent in src/trace.h
+EVENTS = {
+    1: "SLEEP_ENTER",
+    2: "SLEEP_EXIT",
+    3: "WAKEUP",
+    4: "BARO_START",
+    5: "PARSE_DONE",
+    6: "TX_START",
+    7: "TX_DONE",
+    8: "TX_TIMEOUT",
+}
+ARGS = {
+    "SLEEP_ENTER": "tts {} ms",
+    "SLEEP_EXIT": "source {}",
+    "BARO_START": "conversion {} ms",
+    "PARSE_DONE": "{} bytes",
+    "TX_START": "{} bytes",
+    "TX_DONE": "{} ms",
+    "TX_TIMEOUT": "{} ms",
+}
+WAKEUP_SOURCES = ["NONE", "RTC", "EIC", "WDT"]
+
+
+def read_serial(port, baud, timeout):
+    import serial  # pyserial, only needed for live dumps
+    with serial.Serial(port, baud, timeout=0.2) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"TRACE=1\n")
+        buf = b""
+        end = time() + timeout
+        while time() < end:
+            buf += ser.read(4096)
+            pos = buf.find(MAGIC)
+            if pos >= 0 and len(buf) >= pos + HEADER.size:
+                _, _, size, count, _ = HEADER.unpack_from(buf, pos)
+                if len(buf) >= pos + HEADER.size + size * count:
+                    break
+            sleep(0.05)
+        return buf
+
+
+def parse(buf):
+    pos = buf.find(MAGIC)  # text log output may come before the dump
+    if pos < 0 or len(buf) < pos + HEADER.size:
+        raise ValueError("no trace dump found")
+    _, version, size, count, now = HEADER.unpack_from(buf, pos)
+    if version != 1 or size != RECORD.size:
+        raise ValueError("unsupported trace version %d, record size %d" % (version, size))
+    pos += HEADER.size
+    if len(buf) < pos + size * count:
+        raise ValueError("dump truncated, %d of %d records" % ((len(buf) - pos) // size, count))
+    records = []
+    for i in range(count):
+        event, flags, dt, arg = RECORD.unpack_from(buf, pos + i * size)
+        records.append((event, flags, dt, arg))
+    return now, records
+
+
+def describe(name, arg, flags):
+    if name == "SLEEP_EXIT" and arg < len(WAKEUP_SOURCES):
+        text = ARGS[name].format(WAKEUP_SOURCES[arg])
+    elif name in ARGS:
+        text = ARGS[name].format(arg)
+    else:
+        text = ""
+    if flags & SATURATED:
+        text += " (saturated)"
+    return text
+
+
+# split the records into wakes: a wake starts at SLEEP_EXIT and ends at the next SLEEP_ENTER
+def render(records, slow):
+    wakes = []
+    wake = None
+    t = 0
+    for event, flags, dt, arg in records:
+        t += dt
+        name = EVENTS.get(event, "EVENT_%d" % event)
+        if name == "SLEEP_EXIT" or wake is None:
+            wake = {"start": t, "lines": [], "awake": None, "slept": dt if name == "SLEEP_EXIT" else None}
+            wakes.append(wake)
+        wake["lines"].append((t - wake["start"], dt, name, describe(name, arg, flags)))
+        if name == "SLEEP_ENTER" and wake["awake"] is None:
+            wake["awake"] = t - wake["start"]
+
+    for n, w in enumerate(wakes):
+        awake = w["awake"]
+        mark = "  <-- slow" if awake is not None and awake > slow else ""
+        slept = "" if w["slept"] is None else ", slept %d ms before" % w["slept"]
+        print("wake %d: awake %s ms%s%s" % (n, "?" if awake is None else awake, slept, mark))
+        for offset, dt, name, text in w["lines"]:
+            print("  %+7d ms  (%+6d)  %-12s %s" % (offset, dt, name, text))
+
+    awake = [w["awake"] for w in wakes if w["awake"] is not None]
+    if awake:
+        print("\n%d wakes, awake min %d / avg %d / max %d ms, %d slower than %d ms" % (
+            len(awake), min(awake), sum(awake) // len(awake), max(awake), len([a for a in awake if a > slow]), slow))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the Breezedude wake cycle trace (TRACE=1 dump)")
+    parser.add_argument("source", help="serial port of the station or a file with a saved dump")
+    parser.add_argument("-b", "--baud", type=int, default=115200, help="baud rate for the serial port")
+    parser.add_argument("-o", "--output", help="save the raw dump to this file")
+    parser.add_argument("-s", "--slow", type=int, default=100, help="mark wakes longer than this (ms)")
+    parser.add_argument("-t", "--timeout", type=float, default=3.0, help="seconds to wait for the dump")
+    args = parser.parse_args()
+
+    if os.path.isfile(args.source):
+        with open(args.source, "rb") as f:
+            buf = f.read()
+    else:
+        buf = read_serial(args.source, args.baud, args.timeout)
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(buf)
+
+    try:
+        now, records = parse(buf)
+    except ValueError as e:
+        print(e)
+        sys.exit(1)
+    print("%d records, station time %d ms\n" % (len(records), now))
+    render(records, args.slow)
+
+
+if __name__ == "__main__":
+    main()